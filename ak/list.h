@@ -41,11 +41,15 @@ namespace ak {
         private:
             ListNode<T>* head_;
             ListNode<T>* tail_;
-            system::mutexLock lock;
+            Kernel::spinLock lock;
 
             int size_;
 
-            ListNode<T>* insertInternal(const T &e, ListNode<T>* pos);
+            /**
+             * @brief link and unlink only, called with lock held. Nodes are allocated
+             * before and freed after the lock so the heap never runs with interrupts off
+             */
+            void insertInternal(ListNode<T>* n, ListNode<T>* pos);
             void removeInternal(ListNode<T> *pos);
 
         public:
@@ -87,15 +91,12 @@ namespace ak {
                 return iterator(0);
             }
         };
-    }
 }
 
 using namespace ak;
 
 template <typename T>
-ListNode<T>* List<T>::insertInternal(const T& e, ListNode<T>* pos) {
-    this->lock.lock();
-    ListNode<T>* List<T>::insertInternal(const T &e, ListNode<T>* pos)
+void List<T>::insertInternal(ListNode<T>* n, ListNode<T>* pos) {
     size_++;
 
     n->next = pos;
@@ -108,6 +109,119 @@ ListNode<T>* List<T>::insertInternal(const T& e, ListNode<T>* pos) {
         tail_ = n;
     }
 
-    this->lock.unlock();
-    return n;
-}
\ No newline at end of file
+    if (n->prev)
+        n->prev->next = n;
+    else
+        head_ = n;
+}
+
+template <typename T>
+void List<T>::removeInternal(ListNode<T>* pos) {
+    if (pos->prev)
+        pos->prev->next = pos->next;
+    else
+        head_ = pos->next;
+
+    if (pos->next)
+        pos->next->prev = pos->prev;
+    else
+        tail_ = pos->prev;
+
+    pos->next = 0;
+    pos->prev = 0;
+    size_--;
+}
+
+template <typename T>
+void List<T>::push_back(const T& e) {
+    ListNode<T>* n = new ListNode<T>(e);
+
+    uint32_t flags = this->lock.lockIrqSave();
+    insertInternal(n, 0);
+    this->lock.unlockIrqRestore(flags);
+}
+
+template <typename T>
+void List<T>::push_front(const T& e) {
+    ListNode<T>* n = new ListNode<T>(e);
+
+    uint32_t flags = this->lock.lockIrqSave();
+    insertInternal(n, head_);
+    this->lock.unlockIrqRestore(flags);
+}
+
+template <typename T>
+void List<T>::clear() {
+    uint32_t flags = this->lock.lockIrqSave();
+    ListNode<T>* n = head_;
+    head_ = 0;
+    tail_ = 0;
+    size_ = 0;
+    this->lock.unlockIrqRestore(flags);
+
+    while (n) {
+        ListNode<T>* next = n->next;
+        delete n;
+        n = next;
+    }
+}
+
+template <typename T>
+T List<T>::getat(int index) {
+    uint32_t flags = this->lock.lockIrqSave();
+    ListNode<T>* n = head_;
+    while (index-- > 0 && n)
+        n = n->next;
+
+    T result = n ? n->data : T();
+    this->lock.unlockIrqRestore(flags);
+    return result;
+}
+
+template <typename T>
+T List<T>::operator[](int index) {
+    return getat(index);
+}
+
+template <typename T>
+int List<T>::indexof(const T& e) {
+    uint32_t flags = this->lock.lockIrqSave();
+    int index = 0;
+    for (ListNode<T>* n = head_; n; n = n->next, index++) {
+        if (n->data == e) {
+            this->lock.unlockIrqRestore(flags);
+            return index;
+        }
+    }
+
+    this->lock.unlockIrqRestore(flags);
+    return -1;
+}
+
+template <typename T>
+void List<T>::remove(int index) {
+    uint32_t flags = this->lock.lockIrqSave();
+    ListNode<T>* n = head_;
+    while (index-- > 0 && n)
+        n = n->next;
+
+    if (n)
+        removeInternal(n);
+    this->lock.unlockIrqRestore(flags);
+
+    delete n;
+}
+
+template <typename T>
+void List<T>::remove(const T& e) {
+    uint32_t flags = this->lock.lockIrqSave();
+    ListNode<T>* n = head_;
+    while (n && !(n->data == e))
+        n = n->next;
+
+    if (n)
+        removeInternal(n);
+    this->lock.unlockIrqRestore(flags);
+
+    delete n;
+}
@@ -2,50 +2,222 @@
 
 using namespace ak;
 
+bool memOperator::useSSE2 = false;
+
+typedef uint32_t __attribute__((may_alias)) aliasedWord;
+
+static inline void copyBytes(unsigned char* dst, const unsigned char* src, uint32_t size) {
+    for (uint32_t i = 0; i < size; i++)
+        dst[i] = src[i];
+}
+
+static inline void copyDwords(unsigned char* dst, const unsigned char* src, uint32_t size) {
+    unsigned long dwords = size >> 2;
+    asm volatile ("cld; rep movsl" : "+D" (dst), "+S" (src), "+c" (dwords) :: "memory");
+    copyBytes(dst, src, size & 3);
+}
+
+/* the xmm registers are saved and restored inside the same asm statement, so they never need to
+   appear in a clobber list, which gcc refuses anyway while the kernel is built without -msse */
+#define XMM_SAVE(area) \
+    "movdqu %%xmm0, (" area ")\n\t" \
+    "movdqu %%xmm1, 16(" area ")\n\t" \
+    "movdqu %%xmm2, 32(" area ")\n\t" \
+    "movdqu %%xmm3, 48(" area ")\n\t"
+
+#define XMM_RESTORE(area) \
+    "movdqu (" area "), %%xmm0\n\t" \
+    "movdqu 16(" area "), %%xmm1\n\t" \
+    "movdqu 32(" area "), %%xmm2\n\t" \
+    "movdqu 48(" area "), %%xmm3\n\t"
+
+/**
+ * @brief copies blocks * 64 bytes with 128 bit moves, dst must be 16 byte aligned
+ */
+static inline void copySSE2(unsigned char* dst, const unsigned char* src, unsigned long blocks) {
+    unsigned char save[64];
+
+    if (((unsigned long)src & 15) == 0) {
+        asm volatile (
+            XMM_SAVE("%3")
+            "1:\n\t"
+            "movdqa (%1), %%xmm0\n\t"
+            "movdqa 16(%1), %%xmm1\n\t"
+            "movdqa 32(%1), %%xmm2\n\t"
+            "movdqa 48(%1), %%xmm3\n\t"
+            "movdqa %%xmm0, (%0)\n\t"
+            "movdqa %%xmm1, 16(%0)\n\t"
+            "movdqa %%xmm2, 32(%0)\n\t"
+            "movdqa %%xmm3, 48(%0)\n\t"
+            "add $64, %1\n\t"
+            "add $64, %0\n\t"
+            "dec %2\n\t"
+            "jnz 1b\n\t"
+            XMM_RESTORE("%3")
+            : "+r" (dst), "+r" (src), "+r" (blocks)
+            : "r" (save)
+            : "memory", "cc");
+    } else {
+        asm volatile (
+            XMM_SAVE("%3")
+            "1:\n\t"
+            "movdqu (%1), %%xmm0\n\t"
+            "movdqu 16(%1), %%xmm1\n\t"
+            "movdqu 32(%1), %%xmm2\n\t"
+            "movdqu 48(%1), %%xmm3\n\t"
+            "movdqa %%xmm0, (%0)\n\t"
+            "movdqa %%xmm1, 16(%0)\n\t"
+            "movdqa %%xmm2, 32(%0)\n\t"
+            "movdqa %%xmm3, 48(%0)\n\t"
+            "add $64, %1\n\t"
+            "add $64, %0\n\t"
+            "dec %2\n\t"
+            "jnz 1b\n\t"
+            XMM_RESTORE("%3")
+            : "+r" (dst), "+r" (src), "+r" (blocks)
+            : "r" (save)
+            : "memory", "cc");
+    }
+}
+
+/**
+ * @brief fills blocks * 64 bytes with pattern, buf must be 16 byte aligned
+ */
+static inline void fillSSE2(unsigned char* buf, uint32_t pattern, unsigned long blocks) {
+    unsigned char save[16];
+
+    asm volatile (
+        "movdqu %%xmm0, (%3)\n\t"
+        "movd %2, %%xmm0\n\t"
+        "pshufd $0, %%xmm0, %%xmm0\n\t"
+        "1:\n\t"
+        "movdqa %%xmm0, (%0)\n\t"
+        "movdqa %%xmm0, 16(%0)\n\t"
+        "movdqa %%xmm0, 32(%0)\n\t"
+        "movdqa %%xmm0, 48(%0)\n\t"
+        "add $64, %0\n\t"
+        "dec %1\n\t"
+        "jnz 1b\n\t"
+        "movdqu (%3), %%xmm0\n\t"
+        : "+r" (buf), "+r" (blocks)
+        : "r" (pattern), "r" (save)
+        : "memory", "cc");
+}
+
+/**
+ * @brief forward copy, also safe for overlapping buffers as long as dst < src
+ */
+static void copyForward(unsigned char* dst, const unsigned char* src, uint32_t size, bool sse2) {
+    if (size < MEMOP_SMALL_SIZE) {
+        copyBytes(dst, src, size);
+        return;
+    }
+
+    if (sse2 && size >= MEMOP_SSE2_SIZE) {
+        uint32_t head = (16 - ((unsigned long)dst & 15)) & 15;
+        copyBytes(dst, src, head);
+        dst += head;
+        src += head;
+        size -= head;
+
+        uint32_t bulk = size & ~63;
+        copySSE2(dst, src, bulk >> 6);
+        dst += bulk;
+        src += bulk;
+        size -= bulk;
+    }
+
+    copyDwords(dst, src, size);
+}
+
+void memOperator::enableSSE2() {
+    useSSE2 = true;
+}
+
+void memOperator::disableSSE2() {
+    useSSE2 = false;
+}
+
 void* memOperator::memmove(void* dstptr, const void* srcptr, uint32_t size) {
     unsigned char* dst = (unsigned char*) dstptr;
-	const unsigned char* src = (const unsigned char*) srcptr;
-    
-	if (dst < src) {
-		for (uint32_t i = 0; i < size; i++)
-			dst[i] = src[i];
-	} else {
-		for (uint32_t i = size; i != 0; i--)
-			dst[i-1] = src[i-1];
-	}
+    const unsigned char* src = (const unsigned char*) srcptr;
+
+    if (dst == src || size == 0)
+        return dstptr;
+
+    if (dst < src || dst >= src + size) {
+        copyForward(dst, src, size, useSSE2);
+        return dstptr;
+    }
 
-	return dstptr;
+    uint32_t i = size;
+
+    /* backwards rep movsd needs std, which is microcoded and slow, so use a dword loop */
+    if (size >= MEMOP_SMALL_SIZE) {
+        for (; i >= 4; i -= 4)
+            *(aliasedWord*)(dst + i - 4) = *(const aliasedWord*)(src + i - 4);
+    }
+
+    for (; i != 0; i--)
+        dst[i-1] = src[i-1];
+
+    return dstptr;
 }
 
 int memOperator::memcmp(const void* aptr, const void* bptr, uint32_t size) {
     const unsigned char* a = (const unsigned char*) aptr;
-	const unsigned char* b = (const unsigned char*) bptr;
+    const unsigned char* b = (const unsigned char*) bptr;
+    uint32_t i = 0;
 
-	for (uint32_t i = 0; i < size; i++) {
-		if (a[i] < b[i])
-			return -1;
-		else if (b[i] < a[i])
-			return 1;
-	}
+    if (size >= MEMOP_SMALL_SIZE) {
+        for (; i + 4 <= size; i += 4)
+            if (*(const aliasedWord*)(a + i) != *(const aliasedWord*)(b + i))
+                break;
+    }
 
-	return 0;
+    for (; i < size; i++) {
+        if (a[i] < b[i])
+            return -1;
+        else if (b[i] < a[i])
+            return 1;
+    }
+
+    return 0;
 }
 
 void* memOperator::memset(void* bufptr, char value, uint32_t size) {
     unsigned char* buf = (unsigned char*) bufptr;
-    
-	for (uint32_t i = 0; i < size; i++)
-		buf[i] = (unsigned char) value;
 
-	return bufptr;
-}
+    if (size < MEMOP_SMALL_SIZE) {
+        for (uint32_t i = 0; i < size; i++)
+            buf[i] = (unsigned char) value;
+        return bufptr;
+    }
 
-void* memOperator::memcpy(void* dstptr, const void* srcptr, uint32_t size) {
-    unsigned char* dst = (unsigned char*) dstptr;
-	const unsigned char* src = (const unsigned char*) srcptr;
+    uint32_t pattern = (unsigned char) value * 0x01010101u;
+
+    if (useSSE2 && size >= MEMOP_SSE2_SIZE) {
+        uint32_t head = (16 - ((unsigned long)buf & 15)) & 15;
+        for (uint32_t i = 0; i < head; i++)
+            buf[i] = (unsigned char) value;
+        buf += head;
+        size -= head;
+
+        fillSSE2(buf, pattern, size >> 6);
+        buf += size & ~63;
+        size &= 63;
+    }
+
+    unsigned long dwords = size >> 2;
+    asm volatile ("cld; rep stosl" : "+D" (buf), "+c" (dwords) : "a" (pattern) : "memory");
 
-	for (uint32_t i = 0; i < size; i++)
-		dst[i] = src[i];
+    for (uint32_t i = 0; i < (size & 3); i++)
+        buf[i] = (unsigned char) value;
 
-	return dstptr;
-}
\ No newline at end of file
+    return bufptr;
+}
+
+void* memOperator::memcpy(void* dstptr, const void* srcptr, uint32_t size) {
+    copyForward((unsigned char*) dstptr, (const unsigned char*) srcptr, size, useSSE2);
+    return dstptr;
+}
@@ -6,11 +6,31 @@ namespace ak {
         #define phys2virt(x) ((x) + 3_GB)
         #define virt2phys(x) ((x) - 3_GB)
 
+        /**
+         * @brief sizes below MEMOP_SMALL_SIZE use plain byte loops, sizes from MEMOP_SSE2_SIZE
+         * use 128-bit loops once enableSSE2 was called, everything in between uses rep movsd / rep stosd
+         */
+        #define MEMOP_SMALL_SIZE 32
+        #define MEMOP_SSE2_SIZE 2048
+
         class memOperator {
         public:
             static void* memmove(void* dstptr, const void* srcptr, uint32_t size);
             static int memcmp(const void* aptr, const void* bptr, uint32_t size);
             static void* memset(void* bufptr, char value, uint32_t size);
             static void* memcpy(void* dstptr, const void* srcptr, uint32_t size);
+
+            /**
+             * @brief called by Cpu::enableFeatures once sse is on, unless the cpu has fast strings
+             * (ERMSB) and rep movsd is faster anyway. The loops save and restore the
+             * xmm registers they use, so they never own any sse state and are safe from interrupts
+             * and under a user task's registers. A scheduler switching fpu state lazily through
+             * CR0.TS must leave TS clear while in the kernel or call disableSSE2
+             */
+            static void enableSSE2();
+            static void disableSSE2();
+
+        private:
+            static bool useSSE2;
         };
-}
\ No newline at end of file
+}
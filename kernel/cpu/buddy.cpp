@@ -0,0 +1,220 @@
+//
+//  buddy.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 13/01/22.
+//
+
+#include "buddy.h"
+#include <system/log.h>
+
+using namespace Kernel;
+using namespace Kernel::core;
+using namespace Kernel::system;
+using namespace pranaOS::ak;
+
+uint32_t buddyAllocator::zoneStart = 0;
+uint32_t buddyAllocator::zoneBlocks = 0;
+
+uint16_t buddyAllocator::freeHead[BUDDY_MAX_ORDER + 1];
+uint32_t buddyAllocator::freeCount[BUDDY_MAX_ORDER + 1];
+uint16_t buddyAllocator::nextFree[BUDDY_ZONE_BLOCKS];
+uint16_t buddyAllocator::prevFree[BUDDY_ZONE_BLOCKS];
+uint8_t buddyAllocator::blockState[BUDDY_ZONE_BLOCKS];
+
+void buddyAllocator::initialize() {
+    for (uint32_t order = 0; order <= BUDDY_MAX_ORDER; order++) {
+        freeHead[order] = BUDDY_NONE;
+        freeCount[order] = 0;
+    }
+
+    uint32_t totalBlocks = physicalMemoryManager::maximumBlocks;
+
+    zoneBlocks = (totalBlocks / 4) & ~(BUDDY_MAX_BLOCKS - 1);
+    if (zoneBlocks > BUDDY_ZONE_BLOCKS)
+        zoneBlocks = BUDDY_ZONE_BLOCKS;
+
+    if (zoneBlocks == 0)
+        return;
+
+    zoneStart = (totalBlocks - zoneBlocks) & ~(BUDDY_MAX_BLOCKS - 1);
+    physicalMemoryManager::hideBlocks(zoneStart, zoneBlocks);
+
+    for (uint32_t i = 0; i < zoneBlocks; i++)
+        blockState[i] = 0;
+
+    uint32_t index = 0;
+    while (index < zoneBlocks) {
+        if (!rangeFree(index, 0)) {
+            index++;
+            continue;
+        }
+
+        uint32_t order = 0;
+        while (order < BUDDY_MAX_ORDER && (index & ((2 << order) - 1)) == 0 && rangeFree(index, order + 1))
+            order++;
+
+        pushFree(index, order);
+        index += 1 << order;
+    }
+}
+
+uint32_t buddyAllocator::orderForBlocks(uint32_t blocks) {
+    uint32_t order = 0;
+    while ((1u << order) < blocks)
+        order++;
+
+    return order;
+}
+
+uint32_t buddyAllocator::freeBlocksOfOrder(uint32_t order) {
+    return order <= BUDDY_MAX_ORDER ? freeCount[order] : 0;
+}
+
+bool buddyAllocator::contains(void* ptr) {
+    uint32_t frame = (uint32_t)ptr / BLOCK_SIZE;
+    return zoneBlocks && frame >= zoneStart && frame < zoneStart + zoneBlocks;
+}
+
+void buddyAllocator::reserve(uint32_t frame) {
+    if (!zoneBlocks || frame < zoneStart || frame >= zoneStart + zoneBlocks)
+        return;
+
+    uint32_t index = frame - zoneStart;
+
+    uint32_t order = 0;
+    uint32_t head = index;
+    while (order <= BUDDY_MAX_ORDER) {
+        head = index & ~((1u << order) - 1);
+        if (blockState[head] == (BUDDY_FREE | order))
+            break;
+        order++;
+    }
+
+    if (order > BUDDY_MAX_ORDER)
+        return;
+
+    removeFree(head, order);
+
+    while (order > 0) {
+        order--;
+        uint32_t half = head + (1 << order);
+
+        if (index < half)
+            pushFree(half, order);
+        else {
+            pushFree(head, order);
+            head = half;
+        }
+    }
+}
+
+void* buddyAllocator::allocate(uint32_t order) {
+    if (order > BUDDY_MAX_ORDER)
+        return 0;
+
+    uint32_t flags = physicalMemoryManager::bitmapLock.lockIrqSave();
+
+    uint32_t current = order;
+    while (current <= BUDDY_MAX_ORDER && freeHead[current] == BUDDY_NONE)
+        current++;
+
+    if (current > BUDDY_MAX_ORDER) {
+        physicalMemoryManager::bitmapLock.unlockIrqRestore(flags);
+        return 0;
+    }
+
+    uint32_t index = freeHead[current];
+    removeFree(index, current);
+
+    while (current > order) {
+        current--;
+        pushFree(index + (1 << current), current);
+    }
+
+    uint32_t frame = zoneStart + index;
+    for (uint32_t i = 0; i < (1u << order); i++)
+        physicalMemoryManager::setBit(frame + i);
+    physicalMemoryManager::usedBlockCount += 1 << order;
+
+    physicalMemoryManager::bitmapLock.unlockIrqRestore(flags);
+    return (void*)(frame * BLOCK_SIZE);
+}
+
+void buddyAllocator::free(void* ptr, uint32_t order) {
+    if (!contains(ptr) || order > BUDDY_MAX_ORDER)
+        return;
+
+    uint32_t frame = (uint32_t)ptr / BLOCK_SIZE;
+    uint32_t index = frame - zoneStart;
+
+    // a misaligned block would be merged with a buddy it does not own
+    if (((uint32_t)ptr & (BLOCK_SIZE - 1)) || (index & ((1u << order) - 1)) || index + (1u << order) > zoneBlocks) {
+        log(Warning, "buddy: ignoring misaligned free of %x order %d", (uint32_t)ptr, order);
+        return;
+    }
+
+    uint32_t flags = physicalMemoryManager::bitmapLock.lockIrqSave();
+
+    for (uint32_t i = 0; i < (1u << order); i++) {
+        if (!physicalMemoryManager::testBit(frame + i)) {
+            physicalMemoryManager::bitmapLock.unlockIrqRestore(flags);
+            log(Warning, "buddy: ignoring free of unallocated frame %x", (frame + i) * BLOCK_SIZE);
+            return;
+        }
+    }
+
+    for (uint32_t i = 0; i < (1u << order); i++)
+        physicalMemoryManager::unsetBit(frame + i);
+    physicalMemoryManager::usedBlockCount -= 1 << order;
+
+    while (order < BUDDY_MAX_ORDER) {
+        uint32_t buddy = index ^ (1 << order);
+        if (buddy >= zoneBlocks || blockState[buddy] != (BUDDY_FREE | order))
+            break;
+
+        removeFree(buddy, order);
+        index &= ~(1 << order);
+        order++;
+    }
+
+    pushFree(index, order);
+
+    physicalMemoryManager::bitmapLock.unlockIrqRestore(flags);
+}
+
+void buddyAllocator::pushFree(uint32_t index, uint32_t order) {
+    blockState[index] = BUDDY_FREE | order;
+    prevFree[index] = BUDDY_NONE;
+    nextFree[index] = freeHead[order];
+
+    if (freeHead[order] != BUDDY_NONE)
+        prevFree[freeHead[order]] = index;
+
+    freeHead[order] = index;
+    freeCount[order]++;
+}
+
+void buddyAllocator::removeFree(uint32_t index, uint32_t order) {
+    if (prevFree[index] != BUDDY_NONE)
+        nextFree[prevFree[index]] = nextFree[index];
+    else
+        freeHead[order] = nextFree[index];
+
+    if (nextFree[index] != BUDDY_NONE)
+        prevFree[nextFree[index]] = prevFree[index];
+
+    blockState[index] = 0;
+    freeCount[order]--;
+}
+
+bool buddyAllocator::rangeFree(uint32_t index, uint32_t order) {
+    if (index + (1 << order) > zoneBlocks)
+        return false;
+
+    for (uint32_t i = 0; i < (1u << order); i++)
+        if (physicalMemoryManager::testBit(zoneStart + index + i))
+            return false;
+
+    return true;
+}
@@ -0,0 +1,63 @@
+//
+//  buddy.h
+//  pranaOS
+//
+//  Created by Krisna Pranav on 13/01/22.
+//
+
+#pragma once
+
+#include <ak/types.h>
+#include "memory.h"
+
+namespace Kernel {
+    namespace core {
+        #define BUDDY_MAX_ORDER 10
+        #define BUDDY_MAX_BLOCKS (1 << BUDDY_MAX_ORDER)
+        #define BUDDY_ZONE_BLOCKS 8192
+        #define BUDDY_NONE 0xFFFF
+        #define BUDDY_FREE 0x80
+
+        /**
+         * @brief buddy system for power of two physically contiguous ranges (dma buffers, framebuffers, heap growth).
+         * The zone is carved out of the top of memory, free zone blocks stay free in the physicalMemoryManager
+         * bitmap so usedBlocks()/freeBlocks() keep reporting them, they are only hidden from its first fit search.
+         */
+        class buddyAllocator {
+        public:
+            static void initialize();
+
+            static void* allocate(ak::uint32_t order);
+
+            /**
+             * @brief ignores (and logs) blocks not aligned to their order and blocks with a frame
+             * that is not allocated. physicalMemoryManager::freeBlock(s) forwards zone frames here
+             */
+            static void free(void* ptr, ak::uint32_t order);
+
+            static ak::uint32_t orderForBlocks(ak::uint32_t blocks);
+            static ak::uint32_t freeBlocksOfOrder(ak::uint32_t order);
+            static bool contains(void* ptr);
+
+            /**
+             * @brief pulls a frame that is being reserved after the zone was built out of the free lists,
+             * the free block holding it is split and the remaining halves go back on their lists
+             */
+            static void reserve(ak::uint32_t frame);
+
+        private:
+            static ak::uint32_t zoneStart;
+            static ak::uint32_t zoneBlocks;
+
+            static ak::uint16_t freeHead[BUDDY_MAX_ORDER + 1];
+            static ak::uint32_t freeCount[BUDDY_MAX_ORDER + 1];
+            static ak::uint16_t nextFree[BUDDY_ZONE_BLOCKS];
+            static ak::uint16_t prevFree[BUDDY_ZONE_BLOCKS];
+            static ak::uint8_t blockState[BUDDY_ZONE_BLOCKS];
+
+            static void pushFree(ak::uint32_t index, ak::uint32_t order);
+            static void removeFree(ak::uint32_t index, ak::uint32_t order);
+            static bool rangeFree(ak::uint32_t index, ak::uint32_t order);
+        };
+    }
+}
@@ -1,5 +1,5 @@
-GLOBAL EnableSSE
-EnableSSE:
+GLOBAL enableSSE
+enableSSE:
     mov eax, cr0
     and ax, 0xFFFB		
     or ax, 0x2			
@@ -6,14 +6,55 @@
 //
 
 #include "cpu.h"
+#include <ak/memoperator.h>
 #include <system/console.h>
 
 using namespace Kernel;
+using namespace pranaOS::ak;
 
 extern "C" void enableSSE();
 
+bool Cpu::hasRdtscp = false;
+
+// subleaf 0 for the leaves that take one in ecx
 static inline void cpuid(uint32_t reg, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
     asm volatile("cpuid"
         : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
-        : "0" (reg));
+        : "0" (reg), "2" (0));
+}
+
+void Cpu::enableFeatures() {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0x00, &eax, &ebx, &ecx, &edx);
+    uint32_t maxLeaf = eax;
+
+    // with fast strings rep movsd / rep stosd already beat the 128-bit loops at every size
+    bool fastStrings = false;
+    if(maxLeaf >= 0x07) {
+        cpuid(0x07, &eax, &ebx, &ecx, &edx);
+        fastStrings = ebx & EBX_ERMSB;
+    }
+
+    cpuid(0x01, &eax, &ebx, &ecx, &edx);
+
+    if((edx & EDX_SSE2) && (edx & EDX_FXSR)) {
+        enableSSE();
+        if(!fastStrings)
+            ak::memOperator::enableSSE2();
+    }
+
+    cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if(eax >= 0x80000001) {
+        cpuid(0x80000001, &eax, &ebx, &ecx, &edx);
+        hasRdtscp = edx & EDX_RDTSCP;
+    }
+
+    initializeCurrent(0);
+}
+
+void Cpu::initializeCurrent(uint32_t id) {
+    if(!hasRdtscp)
+        return;
+
+    asm volatile("wrmsr" :: "c" (MSR_TSC_AUX), "a" (id), "d" (0));
 }
@@ -5,10 +5,62 @@
 namespace Kernel {
         #define EDX_SSE2 (1 << 26) 
         #define EDX_FXSR (1 << 24) 
+        #define EDX_RDTSCP (1 << 27)
+        #define EBX_ERMSB (1 << 9)
+
+        #define MSR_TSC_AUX 0xC0000103
+        #define MAX_CPUS 8
 
         class Cpu {
         public:
             static void printVendor();
             static void enableFeatures();
+
+            /**
+             * @brief stores the cpu index in TSC_AUX, called by every cpu during bring-up
+             */
+            static void initializeCurrent(ak::uint32_t id);
+
+            /**
+             * @brief index of the executing cpu, read with rdtscp so it costs no cpuid or apic access
+             */
+            static inline ak::uint32_t currentId()
+            {
+                if (!hasRdtscp)
+                    return 0;
+
+                ak::uint32_t low, high, aux;
+                asm volatile ("rdtscp" : "=a" (low), "=d" (high), "=c" (aux));
+                return aux % MAX_CPUS;
+            }
+
+            static inline ak::uint64_t readTimestamp()
+            {
+                ak::uint32_t low, high;
+                asm volatile ("rdtsc" : "=a" (low), "=d" (high));
+                return ((ak::uint64_t)high << 32) | low;
+            }
+
+            static inline ak::uint32_t disableInterrupts()
+            {
+                ak::uint32_t flags;
+                asm volatile ("pushf; pop %0; cli" : "=r" (flags) :: "memory");
+                return flags;
+            }
+
+            static inline void restoreInterrupts(ak::uint32_t flags)
+            {
+                asm volatile ("push %0; popf" :: "r" (flags) : "memory", "cc");
+            }
+
+            static inline bool interruptsEnabled()
+            {
+                ak::uint32_t flags;
+                asm volatile ("pushf; pop %0" : "=r" (flags));
+                return flags & (1 << 9);
+            }
+
+        private:
+            static bool hasRdtscp;
         };        
 }
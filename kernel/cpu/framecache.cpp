@@ -0,0 +1,162 @@
+//
+//  framecache.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 13/01/22.
+//
+
+#include "framecache.h"
+#include <system/log.h>
+
+using namespace Kernel;
+using namespace Kernel::core;
+using namespace Kernel::system;
+using namespace pranaOS::ak;
+
+frameMagazine frameCache::magazines[MAX_CPUS];
+
+void* frameCache::allocate() {
+    uint32_t flags = Cpu::disableInterrupts();
+    frameMagazine* magazine = &magazines[Cpu::currentId()];
+    magazine->lock.lock();
+
+    magazine->statistics.allocations++;
+
+    if (magazine->count == 0)
+        refill(magazine);
+    else
+        magazine->statistics.allocationHits++;
+
+    void* result = 0;
+    if (magazine->count > 0)
+        result = (void*)(magazine->frames[--magazine->count] * BLOCK_SIZE);
+
+    magazine->lock.unlock();
+    Cpu::restoreInterrupts(flags);
+    return result;
+}
+
+void frameCache::free(void* ptr) {
+    uint32_t flags = Cpu::disableInterrupts();
+    frameMagazine* magazine = &magazines[Cpu::currentId()];
+    magazine->lock.lock();
+
+    magazine->statistics.frees++;
+
+    uint32_t frame = (uint32_t)ptr / BLOCK_SIZE;
+    bool invalid = frame >= physicalMemoryManager::maximumBlocks;
+#ifdef FRAME_CACHE_DEBUG
+    invalid = invalid || !physicalMemoryManager::testBit(frame) || isCached(frame);
+#endif
+
+    if (invalid) {
+        magazine->statistics.invalidFrees++;
+        magazine->lock.unlock();
+        Cpu::restoreInterrupts(flags);
+
+        log(Warning, "frame cache: ignoring free of unallocated frame %x", (uint32_t)ptr);
+        return;
+    }
+
+    if (magazine->count == FRAME_MAGAZINE_SIZE)
+        drain(magazine, FRAME_MAGAZINE_BATCH);
+    else
+        magazine->statistics.freeHits++;
+
+    magazine->frames[magazine->count++] = frame;
+
+    magazine->lock.unlock();
+    Cpu::restoreInterrupts(flags);
+}
+
+void frameCache::refill(frameMagazine* magazine) {
+    magazine->statistics.refills++;
+
+    physicalMemoryManager::bitmapLock.lock();
+    while (magazine->count < FRAME_MAGAZINE_BATCH) {
+        uint32_t frame = physicalMemoryManager::takeBlock();
+        if (frame == (uint32_t)-1)
+            break;
+
+        magazine->frames[magazine->count++] = frame;
+    }
+    physicalMemoryManager::bitmapLock.unlock();
+}
+
+void frameCache::drain(frameMagazine* magazine, uint32_t count) {
+    magazine->statistics.drains++;
+
+    physicalMemoryManager::bitmapLock.lock();
+    for (; count > 0 && magazine->count > 0; count--)
+        physicalMemoryManager::releaseBlock(magazine->frames[--magazine->count]);
+    physicalMemoryManager::bitmapLock.unlock();
+}
+
+void frameCache::drainAll() {
+    uint32_t flags = Cpu::disableInterrupts();
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        magazines[cpu].lock.lock();
+        if (magazines[cpu].count > 0)
+            drain(&magazines[cpu], magazines[cpu].count);
+        magazines[cpu].lock.unlock();
+    }
+
+    Cpu::restoreInterrupts(flags);
+}
+
+#ifdef FRAME_CACHE_DEBUG
+/**
+ * @brief catches a frame freed twice while the first free still sits in a magazine,
+ * remote magazines are read without their lock so this is a best effort check
+ */
+bool frameCache::isCached(uint32_t frame) {
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        frameMagazine* magazine = &magazines[cpu];
+        for (uint32_t i = 0; i < magazine->count && i < FRAME_MAGAZINE_SIZE; i++)
+            if (magazine->frames[i] == frame)
+                return true;
+    }
+
+    return false;
+}
+#endif
+
+uint32_t frameCache::cachedBlocks() {
+    uint32_t result = 0;
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+        result += magazines[cpu].count;
+
+    return result;
+}
+
+frameCacheStatistics frameCache::getStatistics(uint32_t cpu) {
+    return magazines[cpu % MAX_CPUS].statistics;
+}
+
+frameCacheStatistics frameCache::getTotalStatistics() {
+    frameCacheStatistics total;
+    ak::memOperator::memset(&total, 0, sizeof(total));
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        frameCacheStatistics* stats = &magazines[cpu].statistics;
+        total.allocations += stats->allocations;
+        total.allocationHits += stats->allocationHits;
+        total.frees += stats->frees;
+        total.freeHits += stats->freeHits;
+        total.refills += stats->refills;
+        total.drains += stats->drains;
+        total.invalidFrees += stats->invalidFrees;
+    }
+
+    return total;
+}
+
+uint32_t frameCache::hitRate() {
+    frameCacheStatistics total = getTotalStatistics();
+    uint32_t operations = total.allocations + total.frees;
+    if (operations == 0)
+        return 100;
+
+    return divide64((uint64_t)(total.allocationHits + total.freeHits) * 100, operations);
+}
@@ -0,0 +1,70 @@
+//
+//  framecache.h
+//  pranaOS
+//
+//  Created by Krisna Pranav on 13/01/22.
+//
+
+#pragma once
+
+#include <ak/types.h>
+#include "cpu.h"
+#include "memory.h"
+#include <tasking/lock.h>
+
+namespace Kernel {
+    namespace core {
+        #define FRAME_MAGAZINE_SIZE 32
+        #define FRAME_MAGAZINE_BATCH 16
+
+        struct frameCacheStatistics {
+            ak::uint32_t allocations;
+            ak::uint32_t allocationHits;
+            ak::uint32_t frees;
+            ak::uint32_t freeHits;
+            ak::uint32_t refills;
+            ak::uint32_t drains;
+            ak::uint32_t invalidFrees;
+        };
+
+        /**
+         * @brief per cpu magazine of free frames, used by its own cpu with interrupts off,
+         * the lock is only contended when drainAll empties it from another cpu
+         */
+        struct frameMagazine {
+            spinLock lock;
+            ak::uint32_t count;
+            ak::uint32_t frames[FRAME_MAGAZINE_SIZE];
+            frameCacheStatistics statistics;
+        } __attribute__((aligned(64)));
+
+        /**
+         * @brief sits in front of the physicalMemoryManager bitmap for single block allocations.
+         * Frames are moved between the bitmap and a magazine FRAME_MAGAZINE_BATCH at a time,
+         * frames held by a magazine stay marked used in the bitmap but are reported as free.
+         * free only touches the local magazine, build with -D FRAME_CACHE_DEBUG to also reject
+         * frames that are free in the bitmap or already sit in a magazine.
+         */
+        class frameCache {
+        public:
+            static void* allocate();
+            static void free(void* ptr);
+
+            static void drainAll();
+            static ak::uint32_t cachedBlocks();
+
+            static frameCacheStatistics getStatistics(ak::uint32_t cpu);
+            static frameCacheStatistics getTotalStatistics();
+            static ak::uint32_t hitRate();
+
+        private:
+            static frameMagazine magazines[MAX_CPUS];
+
+            static void refill(frameMagazine* magazine);
+            static void drain(frameMagazine* magazine, ak::uint32_t count);
+#ifdef FRAME_CACHE_DEBUG
+            static bool isCached(ak::uint32_t frame);
+#endif
+        };
+    }
+}
@@ -0,0 +1,310 @@
+//
+//  memory.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 13/01/22.
+//
+
+#include "memory.h"
+#include "buddy.h"
+#include "framecache.h"
+
+using namespace Kernel;
+using namespace Kernel::core;
+using namespace pranaOS::ak;
+
+uint32_t physicalMemoryManager::memorySize = 0;
+uint32_t physicalMemoryManager::usedBlockCount = 0;
+uint32_t physicalMemoryManager::maximumBlocks = 0;
+uint32_t* physicalMemoryManager::memoryArray = 0;
+spinLock physicalMemoryManager::bitmapLock;
+
+uint32_t physicalMemoryManager::summaryArray[BITMAP_SUMMARY_WORDS];
+uint32_t physicalMemoryManager::bitmapWords = 0;
+uint32_t physicalMemoryManager::nextFreeCursor = 0;
+uint32_t physicalMemoryManager::hiddenStartWord = 0;
+uint32_t physicalMemoryManager::hiddenEndWord = 0;
+
+void physicalMemoryManager::initialize(uint32_t size, uint32_t bitmap) {
+    memorySize = size;
+    maximumBlocks = size / BLOCK_SIZE;
+    usedBlockCount = maximumBlocks;
+    memoryArray = (uint32_t*)bitmap;
+    bitmapWords = (maximumBlocks + 31) / 32;
+    nextFreeCursor = 0;
+    hiddenStartWord = 0;
+    hiddenEndWord = 0;
+
+    ak::memOperator::memset(memoryArray, 0xFF, bitmapWords * sizeof(uint32_t));
+    ak::memOperator::memset(summaryArray, 0, sizeof(summaryArray));
+}
+
+void physicalMemoryManager::setRegionFree(uint32_t base, uint32_t size) {
+    size = pageRoundUp(size);
+    base = pageRoundDown(base);
+
+    uint32_t align = base / BLOCK_SIZE;
+    uint32_t blocks = size / BLOCK_SIZE;
+
+    for (; blocks > 0 && align < maximumBlocks; blocks--, align++) {
+        if (testBit(align)) {
+            unsetBit(align);
+            usedBlockCount--;
+        }
+    }
+
+    if (!testBit(0)) {
+        setBit(0);
+        usedBlockCount++;
+    }
+}
+
+void physicalMemoryManager::setRegionUsed(uint32_t base, uint32_t size) {
+    size = pageRoundUp(size);
+    base = pageRoundDown(base);
+
+    uint32_t align = base / BLOCK_SIZE;
+    uint32_t blocks = size / BLOCK_SIZE;
+
+    for (; blocks > 0 && align < maximumBlocks; blocks--, align++) {
+        if (!testBit(align)) {
+            buddyAllocator::reserve(align);
+            setBit(align);
+            usedBlockCount++;
+        }
+    }
+}
+
+void physicalMemoryManager::parseMemoryMap(const multiboot_info_t* mbi) {
+    grub_multiboot_memory_map_t* mmap = (grub_multiboot_memory_map_t*)mbi->mmap_addr;
+
+    while ((uint32_t)mmap < mbi->mmap_addr + mbi->mmap_length) {
+        if (mmap->type == MULTIBOOT_MEMORY_AVAILABLE)
+            setRegionFree(mmap->base_addr_low, mmap->length_low);
+
+        mmap = (grub_multiboot_memory_map_t*)((uint32_t)mmap + mmap->size + sizeof(mmap->size));
+    }
+
+    buddyAllocator::initialize();
+}
+
+void physicalMemoryManager::hideBlocks(uint32_t firstBlock, uint32_t blocks) {
+    hiddenStartWord = firstBlock / 32;
+    hiddenEndWord = (firstBlock + blocks) / 32;
+
+    for (uint32_t word = hiddenStartWord; word < hiddenEndWord; word++)
+        summaryArray[word / 32] &= ~(1 << (word % 32));
+
+    if (nextFreeCursor >= hiddenStartWord && nextFreeCursor < hiddenEndWord)
+        nextFreeCursor = hiddenEndWord;
+}
+
+/**
+ * @brief first bitmap word at or after fromWord that still has a free block,
+ * walks the summary bitmap so fully used words are skipped 32 at a time
+ */
+uint32_t physicalMemoryManager::nextFreeWord(uint32_t fromWord) {
+    if (fromWord >= bitmapWords)
+        return bitmapWords;
+
+    uint32_t summaryWords = (bitmapWords + 31) / 32;
+    uint32_t index = fromWord / 32;
+    uint32_t bits = summaryArray[index] & (0xFFFFFFFF << (fromWord % 32));
+
+    while (true) {
+        if (bits) {
+            uint32_t word = index * 32 + bitScanForward(bits);
+            return word < bitmapWords ? word : bitmapWords;
+        }
+
+        if (++index >= summaryWords)
+            return bitmapWords;
+
+        bits = summaryArray[index];
+    }
+}
+
+uint32_t physicalMemoryManager::FirstFree() {
+    uint32_t word = nextFreeWord(nextFreeCursor);
+    if (word == bitmapWords)
+        word = nextFreeWord(0);
+
+    if (word == bitmapWords)
+        return (uint32_t)-1;
+
+    nextFreeCursor = word;
+    return word * 32 + bitScanForward(~memoryArray[word]);
+}
+
+uint32_t physicalMemoryManager::FirstFreeSize(uint32_t size) {
+    if (size == 0)
+        return (uint32_t)-1;
+
+    if (size == 1)
+        return FirstFree();
+
+    uint32_t word = nextFreeWord(0);
+    uint32_t frame = word * 32;
+    uint32_t start = 0;
+    uint32_t run = 0;
+
+    while (frame < maximumBlocks) {
+        word = frame / 32;
+
+        if (frame % 32 == 0) {
+            if (word >= hiddenStartWord && word < hiddenEndWord) {
+                run = 0;
+                frame = nextFreeWord(hiddenEndWord) * 32;
+                continue;
+            }
+
+            if (memoryArray[word] == 0) {
+                if (run == 0)
+                    start = frame;
+
+                run += 32;
+                frame += 32;
+
+                if (run >= size)
+                    return start;
+                continue;
+            }
+
+            if (memoryArray[word] == 0xFFFFFFFF) {
+                run = 0;
+                frame = nextFreeWord(word + 1) * 32;
+                continue;
+            }
+        }
+
+        if (!testBit(frame)) {
+            if (run == 0)
+                start = frame;
+
+            if (++run >= size)
+                return start;
+        }
+        else
+            run = 0;
+
+        frame++;
+    }
+
+    return (uint32_t)-1;
+}
+
+uint32_t physicalMemoryManager::takeBlock() {
+    uint32_t frame = FirstFree();
+    if (frame == (uint32_t)-1)
+        return frame;
+
+    setBit(frame);
+    usedBlockCount++;
+
+    return frame;
+}
+
+void physicalMemoryManager::releaseBlock(uint32_t frame) {
+    if (!testBit(frame))
+        return;
+
+    unsetBit(frame);
+    usedBlockCount--;
+}
+
+void* physicalMemoryManager::allocateBlock() {
+    return frameCache::allocate();
+}
+
+void physicalMemoryManager::freeBlock(void* ptr) {
+    // zone frames are only found through the buddy lists, in the bitmap they would be lost for good
+    if (buddyAllocator::contains(ptr)) {
+        buddyAllocator::free(ptr, 0);
+        return;
+    }
+
+    frameCache::free(ptr);
+}
+
+void* physicalMemoryManager::allocateBlocks(uint32_t size) {
+    if (freeBlocks() < size)
+        return 0;
+
+    uint32_t flags = bitmapLock.lockIrqSave();
+
+    uint32_t frame = FirstFreeSize(size);
+    if (frame == (uint32_t)-1) {
+        // frames parked in the magazines may be what splits the run, hand them back and retry once
+        bitmapLock.unlockIrqRestore(flags);
+        if (frameCache::cachedBlocks() == 0)
+            return 0;
+
+        frameCache::drainAll();
+
+        flags = bitmapLock.lockIrqSave();
+        frame = FirstFreeSize(size);
+        if (frame == (uint32_t)-1) {
+            bitmapLock.unlockIrqRestore(flags);
+            return 0;
+        }
+    }
+
+    for (uint32_t i = 0; i < size; i++)
+        setBit(frame + i);
+
+    usedBlockCount += size;
+
+    bitmapLock.unlockIrqRestore(flags);
+    return (void*)(frame * BLOCK_SIZE);
+}
+
+void physicalMemoryManager::freeBlocks(void* ptr, uint32_t size) {
+    uint32_t frame = (uint32_t)ptr / BLOCK_SIZE;
+
+    // ranges never straddle the zone, FirstFreeSize skips it. Single frames merge back into their buddies
+    if (buddyAllocator::contains(ptr)) {
+        for (uint32_t i = 0; i < size; i++)
+            buddyAllocator::free((void*)((frame + i) * BLOCK_SIZE), 0);
+        return;
+    }
+
+    uint32_t flags = bitmapLock.lockIrqSave();
+    for (uint32_t i = 0; i < size; i++)
+        releaseBlock(frame + i);
+    bitmapLock.unlockIrqRestore(flags);
+}
+
+uint32_t physicalMemoryManager::amountOfMemory() {
+    return memorySize;
+}
+
+uint32_t physicalMemoryManager::usedBlocks() {
+    uint32_t cached = frameCache::cachedBlocks();
+    uint32_t used = usedBlockCount;
+
+    return used > cached ? used - cached : 0;
+}
+
+uint32_t physicalMemoryManager::freeBlocks() {
+    return maximumBlocks - usedBlocks();
+}
+
+uint32_t physicalMemoryManager::totalBlocks() {
+    return maximumBlocks;
+}
+
+uint32_t physicalMemoryManager::getBitmapSize() {
+    return memorySize / BLOCK_SIZE / BLOCKS_PER_BYTE;
+}
+
+uint32_t Kernel::core::pageRoundUp(uint32_t address) {
+    if ((address & 0xFFFFF000) != address) {
+        address &= 0xFFFFF000;
+        address += 0x1000;
+    }
+    return address;
+}
+
+uint32_t Kernel::core::pageRoundDown(uint32_t address) {
+    return address & 0xFFFFF000;
+}
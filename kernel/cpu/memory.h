@@ -12,11 +12,13 @@
 #include <ak/memoperator.h>
 #include <system/console.h>
 #include <multiboot/multiboot.h>
+#include <tasking/lock.h>
 
 namespace Kernel {
     namespace core {
         #define BLOCK_SIZE 4_KB
         #define BLOCKS_PER_BYTE 8
+        #define BITMAP_SUMMARY_WORDS 1024
 
         typedef struct multibootMemoryMap {
             unsigned int size;
@@ -27,7 +29,13 @@ namespace Kernel {
             unsigned int type;
         }  __attribute__((packed)) grub_multiboot_memory_map_t;
 
+        class buddyAllocator;
+        class frameCache;
+
         class physicalMemoryManager {
+            friend class buddyAllocator;
+            friend class frameCache;
+
         public:
             static void initialize(ak::uint32_t size, ak::uint32_t bitmap);
             static void setRegionFree(ak::uint32_t base, ak::uint32_t size);
@@ -47,23 +55,55 @@ namespace Kernel {
             
         private:
             static ak::uint32_t memorySize;
-            static ak::uint32_t usedBlocks;
+            static ak::uint32_t usedBlockCount;
             static ak::uint32_t maximumBlocks;
             static ak::uint32_t* memoryArray;
+            static spinLock bitmapLock;
+
+            /**
+             * @brief one bit per memoryArray word, set when that word still has a free block.
+             * 1024 words cover the full 4 GB address space.
+             */
+            static ak::uint32_t summaryArray[BITMAP_SUMMARY_WORDS];
+            static ak::uint32_t bitmapWords;
+            static ak::uint32_t nextFreeCursor;
 
+            /**
+             * @brief bitmap words owned by another allocator (the buddy zone),
+             * they are kept out of the summary so FirstFree never hands them out
+             */
+            static ak::uint32_t hiddenStartWord;
+            static ak::uint32_t hiddenEndWord;
+
+            static inline ak::uint32_t bitScanForward(ak::uint32_t value)
+            {
+                ak::uint32_t index;
+                asm ("bsf %1, %0" : "=r" (index) : "rm" (value));
+                return index;
+            }
             static inline void setBit (ak::uint32_t bit)
             {
-                memoryArray[bit / 32] |= (1 << (bit % 32));
+                ak::uint32_t word = bit / 32;
+                memoryArray[word] |= (1 << (bit % 32));
+                if (memoryArray[word] == 0xFFFFFFFF)
+                    summaryArray[word / 32] &= ~(1 << (word % 32));
             }
             static inline void unsetBit (ak::uint32_t bit)
             {
-                memoryArray[bit / 32] &= ~ (1 << (bit % 32));
+                ak::uint32_t word = bit / 32;
+                memoryArray[word] &= ~ (1 << (bit % 32));
+                if (word < hiddenStartWord || word >= hiddenEndWord)
+                    summaryArray[word / 32] |= (1 << (word % 32));
             }
             static inline bool testBit (ak::uint32_t bit)
             {
                 return memoryArray[bit / 32] &  (1 << (bit % 32));
             }
 
+            static ak::uint32_t takeBlock ();
+            static void releaseBlock (ak::uint32_t frame);
+            static void hideBlocks (ak::uint32_t firstBlock, ak::uint32_t blocks);
+            static ak::uint32_t nextFreeWord (ak::uint32_t fromWord);
             static ak::uint32_t FirstFree ();
             static ak::uint32_t FirstFreeSize (ak::uint32_t size);
         };
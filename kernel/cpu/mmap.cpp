@@ -0,0 +1,249 @@
+//
+//  mmap.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 22/01/22.
+//
+
+#include "mmap.h"
+#include "memory.h"
+#include "paging.h"
+#include <system/log.h>
+#include <system/trace.h>
+
+using namespace Kernel;
+using namespace Kernel::core;
+using namespace Kernel::system;
+using namespace pranaOS;
+using namespace pranaOS::ak;
+
+memoryMapTable memoryMapTable::table;
+
+memoryMapTable::memoryMapTable() {
+    for(int i = 0; i < MAX_MAPPED_REGIONS; i++)
+        regions[i].used = false;
+}
+
+void memoryMapTable::initialize() {
+    virtualMemoryManager::initialize();
+    new pageFaultHandler();
+}
+
+memoryMapTable* memoryMapTable::get() {
+    return &table;
+}
+
+mappedRegion* memoryMapTable::find(uint32_t address) {
+    for(int i = 0; i < MAX_MAPPED_REGIONS; i++) {
+        mappedRegion* region = &regions[i];
+        if(region->used && address >= region->start && address - region->start < region->length)
+            return region;
+    }
+
+    return 0;
+}
+
+uint32_t memoryMapTable::findGap(uint32_t length) {
+    uint32_t candidate = MMAP_REGION_START;
+
+    // regions are few, restart the scan whenever the candidate overlaps one
+    for(int i = 0; i < MAX_MAPPED_REGIONS; i++) {
+        mappedRegion* region = &regions[i];
+        if(!region->used)
+            continue;
+
+        if(candidate < region->start + region->length && region->start < candidate + length) {
+            candidate = region->start + region->length;
+            if(candidate > MMAP_REGION_END - length)
+                return 0;
+            i = -1;
+        }
+    }
+
+    return candidate;
+}
+
+uint32_t memoryMapTable::map(virtualFileSystem* fs, const vfsInode* inode, uint32_t offset, uint32_t length, int protection) {
+    if(length == 0 || (offset & (PAGE_SIZE - 1)) || inode->isDirectory)
+        return 0;
+
+    length = pageRoundUp(length);
+    if(length > MMAP_REGION_END - MMAP_REGION_START)
+        return 0;
+
+    tableLock.lock();
+
+    mappedRegion* region = 0;
+    for(int i = 0; i < MAX_MAPPED_REGIONS && region == 0; i++)
+        if(!regions[i].used)
+            region = &regions[i];
+
+    uint32_t start = region ? findGap(length) : 0;
+    if(start == 0) {
+        tableLock.unlock();
+        return 0;
+    }
+
+    region->used = true;
+    region->start = start;
+    region->length = length;
+    region->fileOffset = offset;
+    region->protection = protection;
+    region->fs = fs;
+    region->inode = *inode;
+    region->cursor.offset = offset;
+    region->cursor.block = 0;
+    region->cursor.blockStart = 0;
+    readAhead::reset(&region->cursor.readAhead);
+
+    tableLock.unlock();
+    return start;
+}
+
+void memoryMapTable::releasePages(uint32_t start, uint32_t end) {
+    for(uint32_t page = start; page < end; page += PAGE_SIZE) {
+        uint32_t physical = virtualMemoryManager::unmapPage(page);
+        if(physical)
+            physicalMemoryManager::freeBlock((void*)physical);
+    }
+}
+
+int memoryMapTable::unmap(uint32_t address, uint32_t length) {
+    if(address & (PAGE_SIZE - 1))
+        return -1;
+
+    tableLock.lock();
+
+    mappedRegion* region = find(address);
+    if(region == 0) {
+        tableLock.unlock();
+        return -1;
+    }
+
+    uint32_t end = address + pageRoundUp(length);
+    uint32_t regionEnd = region->start + region->length;
+    if(end > regionEnd || length == 0)
+        end = regionEnd;
+
+    releasePages(address, end);
+
+    // only whole regions or their head and tail can go, a hole in the middle keeps the region
+    if(address == region->start && end == regionEnd)
+        region->used = false;
+    else if(address == region->start) {
+        region->fileOffset += end - region->start;
+        region->length = regionEnd - end;
+        region->start = end;
+    }
+    else if(end == regionEnd)
+        region->length = address - region->start;
+
+    tableLock.unlock();
+    return 0;
+}
+
+void memoryMapTable::unmapAll() {
+    tableLock.lock();
+    for(int i = 0; i < MAX_MAPPED_REGIONS; i++) {
+        mappedRegion* region = &regions[i];
+        if(region->used) {
+            releasePages(region->start, region->start + region->length);
+            region->used = false;
+        }
+    }
+    tableLock.unlock();
+}
+
+bool memoryMapTable::resolveFault(uint32_t address) {
+    tableLock.lock();
+
+    mappedRegion* region = find(address);
+    uint32_t page = pageRoundDown(address);
+    if(region == 0 || virtualMemoryManager::getPhysical(page) != 0) {
+        tableLock.unlock();
+        return false;
+    }
+
+    uint32_t frame = (uint32_t)physicalMemoryManager::allocateBlock();
+    if(frame == 0) {
+        tableLock.unlock();
+        return false;
+    }
+
+    // fill the frame through its final address, kernel only until the contents are complete
+    if(!virtualMemoryManager::mapPage(page, frame, PAGE_WRITABLE)) {
+        physicalMemoryManager::freeBlock((void*)frame);
+        tableLock.unlock();
+        return false;
+    }
+
+    uint8_t* data = (uint8_t*)page;
+    uint32_t fileOffset = region->fileOffset + (page - region->start);
+    uint32_t length = 0;
+
+    if(fileOffset < region->inode.size) {
+        length = region->inode.size - fileOffset;
+        if(length > PAGE_SIZE)
+            length = PAGE_SIZE;
+
+        // same rule as seek, the block hint only walks forward
+        if(fileOffset < region->cursor.blockStart) {
+            region->cursor.block = 0;
+            region->cursor.blockStart = 0;
+        }
+        region->cursor.offset = fileOffset;
+
+        int result = region->fs->read(&region->inode, &region->cursor, data, length);
+        if(result < 0) {
+            virtualMemoryManager::unmapPage(page);
+            physicalMemoryManager::freeBlock((void*)frame);
+            tableLock.unlock();
+            return false;
+        }
+        length = result;
+    }
+
+    if(length < PAGE_SIZE)
+        ::ak::memOperator::memset(data + length, 0, PAGE_SIZE - length);
+
+    // the table already exists, so changing the entry cannot fail
+    uint32_t flags = PAGE_USER | ((region->protection & VFS_MAP_WRITE) ? PAGE_WRITABLE : 0);
+    virtualMemoryManager::mapPage(page, frame, flags);
+
+    tableLock.unlock();
+    return true;
+}
+
+uint32_t (*pageFaultHandler::terminateHandler)(uint32_t esp, uint32_t address) = 0;
+
+pageFaultHandler::pageFaultHandler()
+: interruptHandler(PAGE_FAULT_INTERRUPT) { }
+
+void pageFaultHandler::setTerminateHandler(uint32_t (*handler)(uint32_t esp, uint32_t address)) {
+    terminateHandler = handler;
+}
+
+uint32_t pageFaultHandler::handleInterrupt(uint32_t esp) {
+    // read cr2 before a nested fault can replace it
+    uint32_t address = virtualMemoryManager::faultAddress();
+
+    // the fill sleeps on the table lock and the disk, the ide irq has to get through or the dma
+    // times out and the drive drops to pio for good. Mapped regions are only touched from user
+    // mode and from syscalls copying user buffers, both run with interrupts on
+    asm volatile ("sti" ::: "memory");
+    bool resolved = memoryMapTable::get()->resolveFault(address);
+    asm volatile ("cli" ::: "memory");
+
+    if(resolved)
+        return esp;
+
+    if(terminateHandler)
+        return terminateHandler(esp, address);
+
+    // returning would only run into the same fault again
+    log(Error, "unresolved page fault at %x", address);
+    traceManager::dump();
+
+    while(true)
+        asm volatile ("cli; hlt");
+}
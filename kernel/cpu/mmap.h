@@ -0,0 +1,93 @@
+//
+//  mmap.h
+//  pranaOS
+//
+//  Created by Krisna Pranav on 22/01/22.
+//
+
+#pragma once
+
+#include <ak/types.h>
+#include <tasking/lock.h>
+#include <system/interrupthandler.h>
+#include <filesystem/vfs.h>
+
+namespace Kernel {
+    namespace core {
+        #define MAX_MAPPED_REGIONS 16
+        #define MMAP_REGION_START 0x80000000
+        #define MMAP_REGION_END 0xBFC00000
+
+        // same values as the libc side in vfs.h
+        #define VFS_MAP_READ (1 << 0)
+        #define VFS_MAP_WRITE (1 << 1)
+
+        /**
+         * @brief file range mapped at [start, start + length), pages are only read in when
+         * first touched, the cursor keeps the cluster of the last fault for the next one
+         */
+        struct mappedRegion {
+            bool used;
+            ak::uint32_t start;
+            ak::uint32_t length;
+            ak::uint32_t fileOffset;
+            int protection;
+
+            virtualFileSystem* fs;
+            vfsInode inode;
+            vfsCursor cursor;
+        };
+
+        /**
+         * @brief table behind SYSCALL_MMAP and SYSCALL_MUNMAP. There is one page directory,
+         * so there is one table for everybody until processes get directories of their own.
+         * Writes go to private copies of the pages and are dropped at unmap.
+         */
+        class memoryMapTable {
+        public:
+            memoryMapTable();
+
+            /**
+             * @brief sets up paging and installs the page fault handler
+             */
+            static void initialize();
+            static memoryMapTable* get();
+
+            ak::uint32_t map(virtualFileSystem* fs, const vfsInode* inode, ak::uint32_t offset, ak::uint32_t length, int protection);
+            int unmap(ak::uint32_t address, ak::uint32_t length);
+            void unmapAll();
+
+            /**
+             * @brief reads in the page behind a fault, false when the address is not mapped
+             * or the page is already present (a write to a read only mapping)
+             */
+            bool resolveFault(ak::uint32_t address);
+
+        private:
+            mappedRegion regions[MAX_MAPPED_REGIONS];
+            mutexLock tableLock;
+
+            static memoryMapTable table;
+
+            mappedRegion* find(ak::uint32_t address);
+            ak::uint32_t findGap(ak::uint32_t length);
+            void releasePages(ak::uint32_t start, ak::uint32_t end);
+        };
+
+        class pageFaultHandler : public system::interruptHandler {
+        public:
+            pageFaultHandler();
+            ak::uint32_t handleInterrupt(ak::uint32_t esp);
+
+            /**
+             * @brief called for faults nothing could resolve, gets the faulting address and
+             * returns the esp to continue with, meant for the scheduler to kill the process.
+             * Without one an unresolved fault halts the system
+             */
+            static void setTerminateHandler(ak::uint32_t (*handler)(ak::uint32_t esp, ak::uint32_t address));
+
+        private:
+            static ak::uint32_t (*terminateHandler)(ak::uint32_t esp, ak::uint32_t address);
+        };
+    }
+}
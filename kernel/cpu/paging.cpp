@@ -0,0 +1,137 @@
+//
+//  paging.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 22/01/22.
+//
+
+#include "paging.h"
+#include "memory.h"
+
+using namespace Kernel;
+using namespace Kernel::core;
+using namespace pranaOS;
+using namespace pranaOS::ak;
+
+spinLock virtualMemoryManager::tableLock;
+uint32_t virtualMemoryManager::windowNext = KERNEL_WINDOW_START;
+uint32_t virtualMemoryManager::windowTable[1024] __attribute__((aligned(4096)));
+
+void virtualMemoryManager::initialize() {
+    uint32_t cr3;
+    asm volatile ("mov %%cr3, %0" : "=r" (cr3));
+    cr3 &= 0xFFFFF000;
+
+    // the boot directory is part of the kernel image, so it is still reachable through the boot mapping
+    uint32_t* directory = (uint32_t*)phys2virt(cr3);
+    directory[PAGE_DIRECTORY_RECURSIVE] = cr3 | PAGE_PRESENT | PAGE_WRITABLE;
+
+    ::ak::memOperator::memset(windowTable, 0, sizeof(windowTable));
+    directory[KERNEL_WINDOW_START >> 22] = virt2phys((uint32_t)windowTable) | PAGE_PRESENT | PAGE_WRITABLE;
+
+    asm volatile ("mov %0, %%cr3" :: "r" (cr3) : "memory");
+}
+
+uint32_t* virtualMemoryManager::pageDirectory() {
+    return (uint32_t*)PAGE_DIRECTORY_ADDRESS;
+}
+
+uint32_t* virtualMemoryManager::pageTable(uint32_t virtualAddress, bool create) {
+    uint32_t* directory = pageDirectory();
+    uint32_t index = virtualAddress >> 22;
+    uint32_t* table = (uint32_t*)(PAGE_TABLES_BASE + index * PAGE_SIZE);
+
+    if(directory[index] & PAGE_PRESENT)
+        return (directory[index] & PAGE_LARGE) ? 0 : table;
+
+    if(!create)
+        return 0;
+
+    uint32_t frame = (uint32_t)physicalMemoryManager::allocateBlock();
+    if(frame == 0)
+        return 0;
+
+    // only tables below the kernel may hold user pages
+    directory[index] = frame | PAGE_PRESENT | PAGE_WRITABLE | (virtualAddress < 3_GB ? PAGE_USER : 0);
+    invalidate((uint32_t)table);
+
+    ::ak::memOperator::memset(table, 0, PAGE_SIZE);
+    return table;
+}
+
+bool virtualMemoryManager::mapPage(uint32_t virtualAddress, uint32_t physicalAddress, uint32_t flags) {
+    uint32_t lockFlags = tableLock.lockIrqSave();
+
+    uint32_t* table = pageTable(virtualAddress, true);
+    if(table == 0) {
+        tableLock.unlockIrqRestore(lockFlags);
+        return false;
+    }
+
+    table[(virtualAddress >> 12) & 0x3FF] = (physicalAddress & 0xFFFFF000) | flags | PAGE_PRESENT;
+    invalidate(virtualAddress);
+
+    tableLock.unlockIrqRestore(lockFlags);
+    return true;
+}
+
+uint32_t virtualMemoryManager::unmapPage(uint32_t virtualAddress) {
+    uint32_t lockFlags = tableLock.lockIrqSave();
+
+    uint32_t* table = pageTable(virtualAddress, false);
+    if(table == 0) {
+        tableLock.unlockIrqRestore(lockFlags);
+        return 0;
+    }
+
+    uint32_t* entry = &table[(virtualAddress >> 12) & 0x3FF];
+    uint32_t physical = (*entry & PAGE_PRESENT) ? (*entry & 0xFFFFF000) : 0;
+    *entry = 0;
+    invalidate(virtualAddress);
+
+    tableLock.unlockIrqRestore(lockFlags);
+    return physical;
+}
+
+uint32_t virtualMemoryManager::getPhysical(uint32_t virtualAddress) {
+    // the boot mapping of the kernel image uses 4 MB pages
+    uint32_t directoryEntry = pageDirectory()[virtualAddress >> 22];
+    if((directoryEntry & PAGE_PRESENT) && (directoryEntry & PAGE_LARGE))
+        return (directoryEntry & 0xFFC00000) | (virtualAddress & 0x3FFFFF);
+
+    uint32_t* table = pageTable(virtualAddress, false);
+    if(table == 0)
+        return 0;
+
+    uint32_t entry = table[(virtualAddress >> 12) & 0x3FF];
+    if(!(entry & PAGE_PRESENT))
+        return 0;
+
+    return (entry & 0xFFFFF000) | (virtualAddress & 0xFFF);
+}
+
+uint32_t virtualMemoryManager::mapPhysical(uint32_t physical, uint32_t size, uint32_t flags) {
+    uint32_t first = pageRoundDown(physical);
+    uint32_t length = pageRoundUp(physical + size) - first;
+
+    uint32_t lockFlags = tableLock.lockIrqSave();
+    if(length == 0 || length > KERNEL_WINDOW_END - windowNext) {
+        tableLock.unlockIrqRestore(lockFlags);
+        return 0;
+    }
+
+    // window space is never given back, mappings made here live as long as the kernel
+    uint32_t base = windowNext;
+    windowNext += length;
+    tableLock.unlockIrqRestore(lockFlags);
+
+    for(uint32_t offset = 0; offset < length; offset += PAGE_SIZE) {
+        if(!mapPage(base + offset, first + offset, flags)) {
+            for(uint32_t undo = 0; undo < offset; undo += PAGE_SIZE)
+                unmapPage(base + undo);
+            return 0;
+        }
+    }
+
+    return base + (physical - first);
+}
@@ -0,0 +1,83 @@
+//
+//  paging.h
+//  pranaOS
+//
+//  Created by Krisna Pranav on 22/01/22.
+//
+
+#pragma once
+
+#include <ak/types.h>
+#include <tasking/lock.h>
+
+namespace Kernel {
+    namespace core {
+        #define PAGE_SIZE 4_KB
+        #define PAGE_PRESENT (1 << 0)
+        #define PAGE_WRITABLE (1 << 1)
+        #define PAGE_USER (1 << 2)
+        #define PAGE_LARGE (1 << 7)
+
+        #define PAGE_FAULT_INTERRUPT 0x0E
+
+        // the last directory entry points at the directory itself, so every page table
+        // shows up at PAGE_TABLES_BASE + index * PAGE_SIZE and the directory at its end
+        #define PAGE_DIRECTORY_RECURSIVE 1023
+        #define PAGE_TABLES_BASE 0xFFC00000
+        #define PAGE_DIRECTORY_ADDRESS 0xFFFFF000
+
+        // kernel virtual addresses handed out by mapPhysical
+        #define KERNEL_WINDOW_START 0xE0000000
+        #define KERNEL_WINDOW_END PAGE_TABLES_BASE
+
+        /**
+         * @brief 4 KB mappings in the active page directory, page tables are allocated on
+         * demand and reached through the recursive directory entry. Only the first 4 MB of
+         * physical memory is mapped at 3 GB, anything else needs a mapping of its own.
+         */
+        class virtualMemoryManager {
+        public:
+            /**
+             * @brief installs the recursive entry and the first page table of the kernel window,
+             * must run before any other call and after the physical memory manager is set up
+             */
+            static void initialize();
+
+            static bool mapPage(ak::uint32_t virtualAddress, ak::uint32_t physicalAddress, ak::uint32_t flags);
+
+            /**
+             * @brief returns the physical address that was mapped or 0
+             */
+            static ak::uint32_t unmapPage(ak::uint32_t virtualAddress);
+            static ak::uint32_t getPhysical(ak::uint32_t virtualAddress);
+
+            /**
+             * @brief maps [physical, physical + size) into the kernel window for good,
+             * returns the virtual address of physical or 0 when the window is full
+             */
+            static ak::uint32_t mapPhysical(ak::uint32_t physical, ak::uint32_t size, ak::uint32_t flags = PAGE_WRITABLE);
+
+            static inline ak::uint32_t faultAddress()
+            {
+                ak::uint32_t address;
+                asm volatile ("mov %%cr2, %0" : "=r" (address));
+                return address;
+            }
+
+            static inline void invalidate(ak::uint32_t virtualAddress)
+            {
+                asm volatile ("invlpg (%0)" :: "r" (virtualAddress) : "memory");
+            }
+
+        private:
+            static spinLock tableLock;
+            static ak::uint32_t windowNext;
+
+            // covers the first 4 MB of the window, so early mappings need no frame for a table
+            static ak::uint32_t windowTable[1024];
+
+            static ak::uint32_t* pageDirectory();
+            static ak::uint32_t* pageTable(ak::uint32_t virtualAddress, bool create);
+        };
+    }
+}
@@ -0,0 +1,481 @@
+//
+//  blockcache.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 18/01/22.
+//
+
+#include "blockcache.h"
+#include "disk.h"
+#include <ak/memoperator.h>
+#include <system/sysinfo.h>
+
+using namespace Kernel;
+using namespace Kernel::system;
+using namespace pranaOS::ak;
+
+blockCacheEntry blockCache::entries[BLOCK_CACHE_ENTRIES];
+uint16_t blockCache::buckets[BLOCK_CACHE_BUCKETS];
+uint16_t blockCache::lruHead = BLOCK_CACHE_NONE;
+uint16_t blockCache::lruTail = BLOCK_CACHE_NONE;
+uint32_t blockCache::dirtyEntries = 0;
+blockCacheStatistics blockCache::statistics;
+mutexLock blockCache::cacheLock;
+
+void blockCache::initialize() {
+    for(uint32_t i = 0; i < BLOCK_CACHE_BUCKETS; i++)
+        buckets[i] = BLOCK_CACHE_NONE;
+
+    // every entry starts out invalid on the lru list, so misses simply take the tail
+    lruHead = lruTail = BLOCK_CACHE_NONE;
+    for(uint16_t i = 0; i < BLOCK_CACHE_ENTRIES; i++) {
+        entries[i].valid = false;
+        entries[i].dirty = false;
+        entries[i].loading = false;
+        entries[i].hashNext = BLOCK_CACHE_NONE;
+        pushLruFront(i);
+    }
+
+    dirtyEntries = 0;
+    ::ak::memOperator::memset(&statistics, 0, sizeof(statistics));
+    systemInfoManager::registerProvider("blockcache", blockCache::getSysInfoValue);
+}
+
+uint32_t blockCache::bucketOf(uint16_t drive, uint32_t lba) {
+    return (((lba ^ (drive << 24)) * 0x9E3779B1) >> 16) % BLOCK_CACHE_BUCKETS;
+}
+
+uint16_t blockCache::lookup(uint16_t drive, uint32_t lba) {
+    uint16_t index = buckets[bucketOf(drive, lba)];
+
+    while(index != BLOCK_CACHE_NONE) {
+        blockCacheEntry* entry = &entries[index];
+        if(entry->lba == lba && entry->drive == drive)
+            return index;
+        index = entry->hashNext;
+    }
+
+    return BLOCK_CACHE_NONE;
+}
+
+void blockCache::unlinkHash(uint16_t index) {
+    blockCacheEntry* entry = &entries[index];
+    uint16_t* link = &buckets[bucketOf(entry->drive, entry->lba)];
+
+    while(*link != BLOCK_CACHE_NONE) {
+        if(*link == index) {
+            *link = entry->hashNext;
+            break;
+        }
+        link = &entries[*link].hashNext;
+    }
+
+    entry->hashNext = BLOCK_CACHE_NONE;
+}
+
+void blockCache::linkHash(uint16_t index) {
+    blockCacheEntry* entry = &entries[index];
+    uint32_t bucket = bucketOf(entry->drive, entry->lba);
+
+    entry->hashNext = buckets[bucket];
+    buckets[bucket] = index;
+}
+
+void blockCache::unlinkLru(uint16_t index) {
+    blockCacheEntry* entry = &entries[index];
+
+    if(entry->lruPrev != BLOCK_CACHE_NONE)
+        entries[entry->lruPrev].lruNext = entry->lruNext;
+    else
+        lruHead = entry->lruNext;
+
+    if(entry->lruNext != BLOCK_CACHE_NONE)
+        entries[entry->lruNext].lruPrev = entry->lruPrev;
+    else
+        lruTail = entry->lruPrev;
+}
+
+void blockCache::pushLruFront(uint16_t index) {
+    blockCacheEntry* entry = &entries[index];
+
+    entry->lruPrev = BLOCK_CACHE_NONE;
+    entry->lruNext = lruHead;
+
+    if(lruHead != BLOCK_CACHE_NONE)
+        entries[lruHead].lruPrev = index;
+    else
+        lruTail = index;
+
+    lruHead = index;
+}
+
+void blockCache::pushLruTail(uint16_t index) {
+    blockCacheEntry* entry = &entries[index];
+
+    entry->lruNext = BLOCK_CACHE_NONE;
+    entry->lruPrev = lruTail;
+
+    if(lruTail != BLOCK_CACHE_NONE)
+        entries[lruTail].lruNext = index;
+    else
+        lruHead = index;
+
+    lruTail = index;
+}
+
+char blockCache::writeBack(uint16_t index) {
+    blockCacheEntry* entry = &entries[index];
+    if(!entry->dirty)
+        return 0;
+
+    char result = entry->device->writeSector(entry->lba, entry->data);
+    if(result != 0)
+        return result;
+
+    entry->dirty = false;
+    dirtyEntries--;
+    statistics.writeBacks++;
+    return 0;
+}
+
+/**
+ * @brief takes the least recently used entry for a new sector, returns BLOCK_CACHE_NONE
+ * when its old dirty content could not be written back
+ */
+uint16_t blockCache::recycle(disk* device, uint16_t drive, uint32_t lba) {
+    uint16_t index = lruTail;
+    while(index != BLOCK_CACHE_NONE && entries[index].loading)
+        index = entries[index].lruPrev;
+
+    if(index == BLOCK_CACHE_NONE)
+        return BLOCK_CACHE_NONE;
+
+    blockCacheEntry* entry = &entries[index];
+
+    if(entry->valid) {
+        if(writeBack(index) != 0)
+            return BLOCK_CACHE_NONE;
+
+        unlinkHash(index);
+        statistics.evictions++;
+    }
+
+    entry->device = device;
+    entry->drive = drive;
+    entry->lba = lba;
+    entry->valid = false;
+    entry->discard = false;
+    entry->prefetched = false;
+    linkHash(index);
+
+    return index;
+}
+
+/**
+ * @brief lookup that waits for a read-ahead in flight on the sector, called and returns
+ * with cacheLock held, the lock is dropped while the disk queue makes progress
+ */
+uint16_t blockCache::lookupSettled(disk* device, uint16_t drive, uint32_t lba) {
+    while(true) {
+        uint16_t index = lookup(drive, lba);
+        if(index == BLOCK_CACHE_NONE || !entries[index].loading)
+            return index;
+
+        cacheLock.unlock();
+        if(device->queue->process() == 0)
+            mutexLock::yield();
+        cacheLock.lock();
+    }
+}
+
+char blockCache::read(disk* device, uint16_t drive, uint32_t lba, uint8_t* buf) {
+    cacheLock.lock();
+
+    uint16_t index = lookupSettled(device, drive, lba);
+    if(index != BLOCK_CACHE_NONE) {
+        statistics.hits++;
+        if(entries[index].prefetched) {
+            entries[index].prefetched = false;
+            statistics.prefetchHits++;
+        }
+    }
+    else {
+        statistics.misses++;
+
+        index = recycle(device, drive, lba);
+        if(index == BLOCK_CACHE_NONE) {
+            cacheLock.unlock();
+            return device->readSector(lba, buf);
+        }
+
+        if(device->readSector(lba, entries[index].data) != 0) {
+            unlinkHash(index);
+            cacheLock.unlock();
+            return 1;
+        }
+        entries[index].valid = true;
+    }
+
+    ::ak::memOperator::memcpy(buf, entries[index].data, BLOCK_CACHE_SECTOR_SIZE);
+    unlinkLru(index);
+    pushLruFront(index);
+
+    cacheLock.unlock();
+    return 0;
+}
+
+char blockCache::write(disk* device, uint16_t drive, uint32_t lba, uint8_t* buf) {
+    cacheLock.lock();
+
+    uint16_t index = lookupSettled(device, drive, lba);
+    if(index == BLOCK_CACHE_NONE) {
+        index = recycle(device, drive, lba);
+        if(index == BLOCK_CACHE_NONE) {
+            cacheLock.unlock();
+            return device->writeSector(lba, buf);
+        }
+        entries[index].valid = true;
+    }
+
+    blockCacheEntry* entry = &entries[index];
+    entry->prefetched = false;
+    ::ak::memOperator::memcpy(entry->data, buf, BLOCK_CACHE_SECTOR_SIZE);
+    if(!entry->dirty) {
+        entry->dirty = true;
+        dirtyEntries++;
+    }
+
+    unlinkLru(index);
+    pushLruFront(index);
+
+    cacheLock.unlock();
+
+    // nothing in the tree runs periodicFlush on a timer yet, so writers keep the backlog bounded
+    if(dirtyEntries >= BLOCK_CACHE_DIRTY_LIMIT)
+        periodicFlush();
+
+    return 0;
+}
+
+void blockCache::flush() {
+    cacheLock.lock();
+    for(uint16_t i = 0; i < BLOCK_CACHE_ENTRIES && dirtyEntries > 0; i++)
+        writeBack(i);
+    cacheLock.unlock();
+}
+
+uint32_t blockCache::periodicFlush() {
+    if(dirtyEntries == 0 || !cacheLock.tryLock())
+        return 0;
+
+    // walk from the cold end, recently written sectors are likely to be written again
+    uint32_t written = 0;
+    uint16_t index = lruTail;
+    while(index != BLOCK_CACHE_NONE && written < BLOCK_CACHE_FLUSH_BATCH && dirtyEntries > 0) {
+        if(entries[index].dirty && writeBack(index) == 0)
+            written++;
+        index = entries[index].lruPrev;
+    }
+
+    cacheLock.unlock();
+    return written;
+}
+
+char blockCache::invalidateAll() {
+    char result = 0;
+
+    cacheLock.lock();
+    for(uint16_t i = 0; i < BLOCK_CACHE_ENTRIES; i++) {
+        if(entries[i].loading) {
+            entries[i].discard = true;
+            continue;
+        }
+
+        if(!entries[i].valid)
+            continue;
+
+        if(writeBack(i) != 0) {
+            result = 1;
+            continue;
+        }
+
+        unlinkHash(i);
+        entries[i].valid = false;
+    }
+    cacheLock.unlock();
+
+    return result;
+}
+
+char blockCache::removeDrive(uint16_t drive) {
+    char result = 0;
+
+    cacheLock.lock();
+    for(uint16_t i = 0; i < BLOCK_CACHE_ENTRIES; i++) {
+        blockCacheEntry* entry = &entries[i];
+        if(entry->loading) {
+            if(entry->drive >= drive)
+                entry->discard = true;
+            continue;
+        }
+
+        if(!entry->valid || entry->drive < drive)
+            continue;
+
+        if(entry->drive > drive) {
+            unlinkHash(i);
+            entry->drive--;
+            linkHash(i);
+            continue;
+        }
+
+        if(writeBack(i) != 0) {
+            // the device is going away, nothing else can take these sectors
+            entry->dirty = false;
+            dirtyEntries--;
+            result = 1;
+        }
+
+        unlinkHash(i);
+        entry->valid = false;
+        unlinkLru(i);
+        pushLruTail(i);
+    }
+    cacheLock.unlock();
+
+    return result;
+}
+
+bool blockCache::inRange(uint16_t index, uint16_t drive, uint32_t lba, uint32_t count) {
+    blockCacheEntry* entry = &entries[index];
+    return entry->valid && entry->drive == drive && entry->lba - lba < count;
+}
+
+char blockCache::writeBackRange(uint16_t drive, uint32_t lba, uint32_t count) {
+    if(dirtyEntries == 0)
+        return 0;
+
+    char result = 0;
+    cacheLock.lock();
+    for(uint16_t i = 0; i < BLOCK_CACHE_ENTRIES; i++) {
+        if(entries[i].dirty && inRange(i, drive, lba, count) && writeBack(i) != 0)
+            result = 1;
+    }
+    cacheLock.unlock();
+
+    return result;
+}
+
+void blockCache::invalidateRange(uint16_t drive, uint32_t lba, uint32_t count) {
+    cacheLock.lock();
+    for(uint16_t i = 0; i < BLOCK_CACHE_ENTRIES; i++) {
+        blockCacheEntry* entry = &entries[i];
+        if(entry->loading && entry->drive == drive && entry->lba - lba < count) {
+            entry->discard = true;
+            continue;
+        }
+
+        if(!inRange(i, drive, lba, count))
+            continue;
+
+        // the sector is about to be overwritten as a whole, so dirty data can be dropped
+        if(entries[i].dirty) {
+            entries[i].dirty = false;
+            dirtyEntries--;
+        }
+
+        unlinkHash(i);
+        entries[i].valid = false;
+        unlinkLru(i);
+        pushLruTail(i);
+    }
+    cacheLock.unlock();
+}
+
+void blockCache::prefetchDone(diskRequest* request, void* context) {
+    blockCacheEntry* entry = (blockCacheEntry*)context;
+
+    cacheLock.lock();
+    if(request->result == 0 && !entry->discard) {
+        entry->valid = true;
+        entry->prefetched = true;
+    }
+    else
+        unlinkHash(entry - entries);
+
+    entry->loading = false;
+    cacheLock.unlock();
+}
+
+uint32_t blockCache::prefetch(disk* device, uint16_t drive, uint32_t lba, uint32_t count) {
+    uint32_t queued = 0;
+
+    cacheLock.lock();
+    for(uint32_t i = 0; i < count; i++) {
+        if(lookup(drive, lba + i) != BLOCK_CACHE_NONE)
+            continue;
+
+        uint16_t index = recycle(device, drive, lba + i);
+        if(index == BLOCK_CACHE_NONE)
+            break;
+
+        blockCacheEntry* entry = &entries[index];
+        entry->loading = true;
+
+        if(device->queue->submit(lba + i, 1, entry->data, false, blockCache::prefetchDone, entry) == 0) {
+            // request pool exhausted, the rest waits for the next window
+            unlinkHash(index);
+            entry->loading = false;
+            break;
+        }
+
+        // read-ahead data has not been used yet, keep it ahead of the coldest entries only
+        unlinkLru(index);
+        pushLruFront(index);
+        queued++;
+    }
+
+    statistics.prefetched += queued;
+    cacheLock.unlock();
+    return queued;
+}
+
+blockCacheStatistics blockCache::getStatistics() {
+    return statistics;
+}
+
+uint32_t blockCache::dirtyCount() {
+    return dirtyEntries;
+}
+
+bool blockCache::getSysInfoValue(const char* path, uint64_t* value) {
+    if(systemInfoManager::isKey(path, "entries"))
+        *value = BLOCK_CACHE_ENTRIES;
+    else if(systemInfoManager::isKey(path, "hits"))
+        *value = statistics.hits;
+    else if(systemInfoManager::isKey(path, "misses"))
+        *value = statistics.misses;
+    else if(systemInfoManager::isKey(path, "hitrate")) {
+        uint64_t hits = statistics.hits;
+        uint64_t total = hits + statistics.misses;
+        while(total >> 32) {
+            hits >>= 1;
+            total >>= 1;
+        }
+        *value = total ? divide64(hits * 100, (uint32_t)total) : 0;
+    }
+    else if(systemInfoManager::isKey(path, "evictions"))
+        *value = statistics.evictions;
+    else if(systemInfoManager::isKey(path, "writebacks"))
+        *value = statistics.writeBacks;
+    else if(systemInfoManager::isKey(path, "prefetched"))
+        *value = statistics.prefetched;
+    else if(systemInfoManager::isKey(path, "prefetchhits"))
+        *value = statistics.prefetchHits;
+    else if(systemInfoManager::isKey(path, "dirty"))
+        *value = dirtyEntries;
+    else
+        return false;
+
+    return true;
+}
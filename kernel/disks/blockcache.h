@@ -0,0 +1,130 @@
+//
+//  blockcache.h
+//  pranaOS
+//
+//  Created by Krisna Pranav on 18/01/22.
+//
+
+#pragma once
+
+#include <ak/types.h>
+#include <tasking/lock.h>
+#include "diskqueue.h"
+
+namespace Kernel {
+    class disk;
+
+    #define BLOCK_CACHE_SECTOR_SIZE 512
+    #define BLOCK_CACHE_ENTRIES 256
+    #define BLOCK_CACHE_BUCKETS 128
+    #define BLOCK_CACHE_NONE 0xFFFF
+    #define BLOCK_CACHE_FLUSH_BATCH 32
+    #define BLOCK_CACHE_DIRTY_LIMIT (BLOCK_CACHE_ENTRIES / 2)
+
+    struct blockCacheEntry {
+        disk* device;
+        ak::uint32_t lba;
+        ak::uint16_t drive;
+        bool valid;
+        bool dirty;
+
+        /**
+         * @brief a queued read-ahead is filling data, discard drops the result
+         * because the sector was overwritten or invalidated meanwhile
+         */
+        volatile bool loading;
+        bool discard;
+        bool prefetched;
+
+        ak::uint16_t hashNext;
+        ak::uint16_t lruPrev;
+        ak::uint16_t lruNext;
+
+        ak::uint8_t data[BLOCK_CACHE_SECTOR_SIZE];
+    };
+
+    struct blockCacheStatistics {
+        ak::uint64_t hits;
+        ak::uint64_t misses;
+        ak::uint64_t evictions;
+        ak::uint64_t writeBacks;
+        ak::uint64_t prefetched;
+        ak::uint64_t prefetchHits;
+    };
+
+    /**
+     * @brief write back sector cache in front of diskManager, keyed by (drive, lba).
+     * A hash index finds entries, the least recently used one is recycled on a miss
+     * and dirty sectors are written out on eviction, flush or periodicFlush.
+     */
+    class blockCache {
+    public:
+        static void initialize();
+
+        static char read(disk* device, ak::uint16_t drive, ak::uint32_t lba, ak::uint8_t* buf);
+        static char write(disk* device, ak::uint16_t drive, ak::uint32_t lba, ak::uint8_t* buf);
+
+        /**
+         * @brief writes back every dirty sector
+         */
+        static void flush();
+
+        /**
+         * @brief writes back at most BLOCK_CACHE_FLUSH_BATCH dirty sectors, oldest first.
+         * Runs from write once BLOCK_CACHE_DIRTY_LIMIT sectors are dirty and from diskManager::processQueues
+         */
+        static ak::uint32_t periodicFlush();
+
+        /**
+         * @brief writes back and drops every entry, entries whose write back fails
+         * stay cached and dirty and the call returns non zero
+         */
+        static char invalidateAll();
+
+        /**
+         * @brief writes back and drops the entries of a drive that goes away and renumbers
+         * the entries of the drives behind it, returns non zero when dirty sectors were lost
+         */
+        static char removeDrive(ak::uint16_t drive);
+
+        /**
+         * @brief keep the cache coherent with multi sector transfers that bypass it
+         */
+        static char writeBackRange(ak::uint16_t drive, ak::uint32_t lba, ak::uint32_t count);
+        static void invalidateRange(ak::uint16_t drive, ak::uint32_t lba, ak::uint32_t count);
+
+        /**
+         * @brief queues reads for the uncached sectors of the range on the disk's request queue
+         * and returns right away, adjacent sectors are merged by the queue into one command.
+         * Returns the number of sectors queued.
+         */
+        static ak::uint32_t prefetch(disk* device, ak::uint16_t drive, ak::uint32_t lba, ak::uint32_t count);
+
+        static blockCacheStatistics getStatistics();
+        static ak::uint32_t dirtyCount();
+
+    private:
+        static blockCacheEntry entries[BLOCK_CACHE_ENTRIES];
+        static ak::uint16_t buckets[BLOCK_CACHE_BUCKETS];
+        static ak::uint16_t lruHead;
+        static ak::uint16_t lruTail;
+        static ak::uint32_t dirtyEntries;
+        static blockCacheStatistics statistics;
+        static mutexLock cacheLock;
+
+        static ak::uint32_t bucketOf(ak::uint16_t drive, ak::uint32_t lba);
+        static ak::uint16_t lookup(ak::uint16_t drive, ak::uint32_t lba);
+        static ak::uint16_t recycle(disk* device, ak::uint16_t drive, ak::uint32_t lba);
+        static void unlinkHash(ak::uint16_t index);
+        static void linkHash(ak::uint16_t index);
+        static void unlinkLru(ak::uint16_t index);
+        static void pushLruFront(ak::uint16_t index);
+        static void pushLruTail(ak::uint16_t index);
+        static char writeBack(ak::uint16_t index);
+        static ak::uint16_t lookupSettled(disk* device, ak::uint16_t drive, ak::uint32_t lba);
+        static void prefetchDone(diskRequest* request, void* context);
+        static bool inRange(ak::uint16_t index, ak::uint16_t drive, ak::uint32_t lba, ak::uint32_t count);
+
+        static bool getSysInfoValue(const char* path, ak::uint64_t* value);
+    };
+}
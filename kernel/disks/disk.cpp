@@ -0,0 +1,65 @@
+//
+//  disk.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 18/01/22.
+//
+
+#include "disk.h"
+
+using namespace Kernel;
+using namespace pranaOS::ak;
+
+disk::disk(uint32_t controllerIndex, diskController* controller, diskType type, uint64_t size, uint32_t blocks, uint32_t blocksize) {
+    this->controllerIndex = controllerIndex;
+    this->controller = controller;
+    this->type = type;
+    this->size = size;
+    this->numBlocks = blocks;
+    this->blockSize = blocksize;
+    this->queue = new diskQueue(disk::queueDispatch, this);
+    readAhead::reset(&this->readAhead);
+}
+
+char disk::queueDispatch(void* device, uint32_t lba, uint32_t count, diskIoVec* vectors, uint32_t vectorCount, bool write) {
+    disk* target = (disk*)device;
+
+    if(write)
+        return target->writeSectors(lba, count, vectors, vectorCount);
+    return target->readSectors(lba, count, vectors, vectorCount);
+}
+
+char disk::readSector(uint32_t lba, uint8_t* buf) {
+    if(this->controller == 0)
+        return 1;
+
+    return this->controller->readSector(this->controllerIndex, lba, buf);
+}
+
+char disk::writeSector(uint32_t lba, uint8_t* buf) {
+    if(this->controller == 0)
+        return 1;
+
+    return this->controller->writeSector(this->controllerIndex, lba, buf);
+}
+
+char disk::readSectors(uint32_t lba, uint32_t count, diskIoVec* vectors, uint32_t vectorCount) {
+    if(this->controller == 0)
+        return 1;
+
+    return this->controller->readSectors(this->controllerIndex, lba, count, vectors, vectorCount);
+}
+
+char disk::writeSectors(uint32_t lba, uint32_t count, diskIoVec* vectors, uint32_t vectorCount) {
+    if(this->controller == 0)
+        return 1;
+
+    return this->controller->writeSectors(this->controllerIndex, lba, count, vectors, vectorCount);
+}
+
+char disk::flushCache() {
+    if(this->controller == 0)
+        return 1;
+
+    return this->controller->flushCache(this->controllerIndex);
+}
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <ak/types.h>
+#include "diskio.h"
 #include "diskcontroller.h"
+#include "diskqueue.h"
+#include "readahead.h"
 
 namespace Kernel {
     
@@ -23,11 +26,23 @@ namespace Kernel {
         ak::uint64_t size;
         ak::uint32_t numBlocks;
         ak::uint32_t blockSize;
+        diskQueue* queue;
+
+        /**
+         * @brief sequential detection for single sector reads through diskManager::readSector
+         */
+        readAheadState readAhead;
 
         disk(ak::uint32_t controllerIndex, diskController* controller, diskType type, ak::uint64_t size, ak::uint32_t blocks, ak::uint32_t blocksize);
             
         virtual char readSector(ak::uint32_t lba, ak::uint8_t* buf);
         virtual char writeSector(ak::uint32_t lba, ak::uint8_t* buf);
+
+        virtual char readSectors(ak::uint32_t lba, ak::uint32_t count, diskIoVec* vectors, ak::uint32_t vectorCount);
+        virtual char writeSectors(ak::uint32_t lba, ak::uint32_t count, diskIoVec* vectors, ak::uint32_t vectorCount);
+        virtual char flushCache();
+
+        static char queueDispatch(void* device, ak::uint32_t lba, ak::uint32_t count, diskIoVec* vectors, ak::uint32_t vectorCount, bool write);
     };
     
 }
\ No newline at end of file
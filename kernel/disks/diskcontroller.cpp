@@ -0,0 +1,55 @@
+//
+//  diskcontroller.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 18/01/22.
+//
+
+#include "diskcontroller.h"
+
+using namespace Kernel;
+using namespace pranaOS::ak;
+
+diskController::diskController() { }
+
+char diskController::readSector(uint16_t drive, uint32_t lba, uint8_t* buf) {
+    return 1;
+}
+
+char diskController::writeSector(uint16_t drive, uint32_t lba, uint8_t* buf) {
+    return 1;
+}
+
+char diskController::readSectors(uint16_t drive, uint32_t lba, uint32_t count, diskIoVec* vectors, uint32_t vectorCount) {
+    for(uint32_t v = 0; v < vectorCount && count > 0; v++) {
+        uint8_t* buffer = vectors[v].buffer;
+
+        for(uint32_t done = 0; done < vectors[v].length && count > 0; done += DISK_SECTOR_SIZE, count--) {
+            if(readSector(drive, lba++, buffer + done) != 0)
+                return 1;
+        }
+    }
+
+    return count == 0 ? 0 : 1;
+}
+
+char diskController::writeSectors(uint16_t drive, uint32_t lba, uint32_t count, diskIoVec* vectors, uint32_t vectorCount) {
+    for(uint32_t v = 0; v < vectorCount && count > 0; v++) {
+        uint8_t* buffer = vectors[v].buffer;
+
+        for(uint32_t done = 0; done < vectors[v].length && count > 0; done += DISK_SECTOR_SIZE, count--) {
+            if(writeSector(drive, lba++, buffer + done) != 0)
+                return 1;
+        }
+    }
+
+    return count == 0 ? 0 : 1;
+}
+
+bool diskController::ejectDrive(uint8_t drive) {
+    return false;
+}
+
+char diskController::flushCache(uint16_t drive) {
+    return 0;
+}
@@ -3,6 +3,7 @@
 #include <ak/types.h>
 #include <ak/convert.h>
 #include <ak/memoperator.h>
+#include "diskio.h"
 #include "disk.h"
 #include "diskmanager.h"
 
@@ -11,8 +12,20 @@ namespace Kernel {
     public:
         diskController();
 
-        char readSector(ak::uint16_t drive, ak::uint32_t lba, ak::uint8_t* buf);
-        char writeSector();
-        bool ejectDrive(ak::uint8_t drive);
+        /**
+         * @brief moves count sectors starting at lba to or from the buffers in vectors,
+         * the default loops over readSector/writeSector, controllers override it with one command
+         */
+        virtual char readSectors(ak::uint16_t drive, ak::uint32_t lba, ak::uint32_t count, diskIoVec* vectors, ak::uint32_t vectorCount);
+        virtual char writeSectors(ak::uint16_t drive, ak::uint32_t lba, ak::uint32_t count, diskIoVec* vectors, ak::uint32_t vectorCount);
+
+        virtual char readSector(ak::uint16_t drive, ak::uint32_t lba, ak::uint8_t* buf);
+        virtual char writeSector(ak::uint16_t drive, ak::uint32_t lba, ak::uint8_t* buf);
+        virtual bool ejectDrive(ak::uint8_t drive);
+
+        /**
+         * @brief commits the drive's volatile write cache to the media, only done on an explicit sync
+         */
+        virtual char flushCache(ak::uint16_t drive);
     };
 }
\ No newline at end of file
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <ak/types.h>
+
+namespace Kernel {
+    #define DISK_SECTOR_SIZE 512
+
+    /**
+     * @brief one piece of a scatter-gather transfer, length is a multiple of DISK_SECTOR_SIZE
+     */
+    struct diskIoVec {
+        ak::uint8_t* buffer;
+        ak::uint32_t length;
+    };
+}
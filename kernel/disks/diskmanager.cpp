@@ -0,0 +1,140 @@
+//
+//  diskmanager.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 18/01/22.
+//
+
+#include "diskmanager.h"
+#include "blockcache.h"
+#include <system/log.h>
+
+using namespace Kernel;
+using namespace Kernel::system;
+using namespace pranaOS::ak;
+
+diskManager::diskManager() {
+    blockCache::initialize();
+}
+
+void diskManager::addDisk(disk* device) {
+    allDisks.push_back(device);
+}
+
+void diskManager::removeDisk(disk* device) {
+    int drive = allDisks.indexof(device);
+    if(drive < 0)
+        return;
+
+    // drive numbers are list positions, the cache renumbers the disks behind this one
+    if(blockCache::removeDrive(drive) != 0)
+        log(Warning, "disk %d removed with dirty sectors that could not be written", drive);
+
+    allDisks.remove(device);
+}
+
+char diskManager::readSector(uint16_t drive, uint32_t lba, uint8_t* buf) {
+    if(drive >= allDisks.size())
+        return 1;
+
+    // filesystems walk their structures sector by sector, a run of these is prefetched like a file.
+    // The state is shared by every reader of the drive and only steers prefetching, so it goes unlocked
+    disk* device = allDisks[drive];
+    readAhead::access(this, drive, &device->readAhead, lba, 1, device->numBlocks);
+
+    return blockCache::read(device, drive, lba, buf);
+}
+
+char diskManager::writeSector(uint16_t drive, uint32_t lba, uint8_t* buf) {
+    if(drive >= allDisks.size())
+        return 1;
+
+    return blockCache::write(allDisks[drive], drive, lba, buf);
+}
+
+char diskManager::flush() {
+    blockCache::flush();
+
+    char result = blockCache::dirtyCount() != 0;
+    for(disk* device : allDisks)
+        if(device->flushCache() != 0)
+            result = 1;
+
+    return result;
+}
+
+char diskManager::readSectors(uint16_t drive, uint32_t lba, uint32_t count, diskIoVec* vectors, uint32_t vectorCount) {
+    if(drive >= allDisks.size() || vectorCount == 0)
+        return 1;
+
+    if(count == 1 && vectors[0].length >= DISK_SECTOR_SIZE)
+        return blockCache::read(allDisks[drive], drive, lba, vectors[0].buffer);
+
+    if(blockCache::writeBackRange(drive, lba, count) != 0)
+        return 1;
+
+    // transfer waits for its own request, so this only merges with read-ahead and other
+    // submit() requests already pending, a lone synchronous caller still sees queue depth 1
+    if(vectorCount == 1)
+        return allDisks[drive]->queue->transfer(lba, count, vectors[0].buffer, false);
+
+    return allDisks[drive]->readSectors(lba, count, vectors, vectorCount);
+}
+
+char diskManager::writeSectors(uint16_t drive, uint32_t lba, uint32_t count, diskIoVec* vectors, uint32_t vectorCount) {
+    if(drive >= allDisks.size() || vectorCount == 0)
+        return 1;
+
+    if(count == 1 && vectors[0].length >= DISK_SECTOR_SIZE)
+        return blockCache::write(allDisks[drive], drive, lba, vectors[0].buffer);
+
+    blockCache::invalidateRange(drive, lba, count);
+
+    if(vectorCount == 1)
+        return allDisks[drive]->queue->transfer(lba, count, vectors[0].buffer, true);
+
+    return allDisks[drive]->writeSectors(lba, count, vectors, vectorCount);
+}
+
+diskRequest* diskManager::submit(uint16_t drive, uint32_t lba, uint32_t count, uint8_t* buffer, bool write, diskRequestCallback callback, void* context) {
+    if(drive >= allDisks.size())
+        return 0;
+
+    if(write)
+        blockCache::invalidateRange(drive, lba, count);
+    else if(blockCache::writeBackRange(drive, lba, count) != 0)
+        return 0;
+
+    return allDisks[drive]->queue->submit(lba, count, buffer, write, callback, context);
+}
+
+char diskManager::readSequential(uint16_t drive, readAheadState* state, uint32_t lba, uint32_t count, uint8_t* buffer, uint32_t limit) {
+    if(drive >= allDisks.size())
+        return 1;
+
+    // queue the next window first, it is dispatched as one merged command when a read
+    // reaches a sector of it or when processQueues runs
+    readAhead::access(this, drive, state, lba, count, limit);
+
+    disk* device = allDisks[drive];
+    for(uint32_t i = 0; i < count; i++) {
+        if(blockCache::read(device, drive, lba + i, buffer + i * DISK_SECTOR_SIZE) != 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+uint32_t diskManager::prefetch(uint16_t drive, uint32_t lba, uint32_t count) {
+    if(drive >= allDisks.size())
+        return 0;
+
+    return blockCache::prefetch(allDisks[drive], drive, lba, count);
+}
+
+void diskManager::processQueues() {
+    for(disk* device : allDisks)
+        device->queue->process();
+
+    blockCache::periodicFlush();
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <ak/types.h>
+#include "diskio.h"
+#include "diskqueue.h"
+#include "readahead.h"
 #include <ak/convert.h>
 #include <ak/string.h>
 #include <ak/memoperator.h>
@@ -29,19 +32,51 @@ namespace Kernel {
         char             interfaceName[8];
     } __attribute__((packed));
 
-    class Disk;
+    class disk;
 
     class diskManager {
     public:
-        List<Disk*> allDisks;
+        List<disk*> allDisks;
         diskManager();
 
-        void addDisk(Disk* disk);
-        void removeDisk(Disk* disk);
+        void addDisk(disk* device);
+        void removeDisk(disk* device);
 
+        /**
+         * @brief sector access goes through blockCache, writes reach the
+         * device on eviction or the next flush. Sequential runs of readSector
+         * are prefetched through the disk's read-ahead state
+         */
         char readSector(ak::uint16_t drive, ak::uint32_t lba, ak::uint8_t* buf);
         char writeSector(ak::uint16_t drive, ak::uint32_t lba, ak::uint8_t* buf);
 
+        /**
+         * @brief writes back every cached sector and then flushes the write cache of every drive
+         */
+        char flush();
+
+        /**
+         * @brief multi sector transfers bypass the cache, cached copies of the range are
+         * written back before a read and dropped before a write
+         */
+        char readSectors(ak::uint16_t drive, ak::uint32_t lba, ak::uint32_t count, diskIoVec* vectors, ak::uint32_t vectorCount);
+        char writeSectors(ak::uint16_t drive, ak::uint32_t lba, ak::uint32_t count, diskIoVec* vectors, ak::uint32_t vectorCount);
+
+        /**
+         * @brief asynchronous transfer through the disk's request queue, see diskQueue::submit
+         */
+        diskRequest* submit(ak::uint16_t drive, ak::uint32_t lba, ak::uint32_t count, ak::uint8_t* buffer, bool write, diskRequestCallback callback, void* context);
+        void processQueues();
+
+        /**
+         * @brief sector reads of an open file, feeds the file's read-ahead state
+         * so sequential streams are prefetched into the block cache. Meant for filesystem
+         * drivers to call from virtualFileSystem::read with the handle's cursor.readAhead,
+         * which keeps interleaved files from breaking up each other's streams
+         */
+        char readSequential(ak::uint16_t drive, readAheadState* state, ak::uint32_t lba, ak::uint32_t count, ak::uint8_t* buffer, ak::uint32_t limit);
+        ak::uint32_t prefetch(ak::uint16_t drive, ak::uint32_t lba, ak::uint32_t count);
+
         biosDriveParameters* getDriveInfoBios(ak::uint8_t drive);
     };
 }
\ No newline at end of file
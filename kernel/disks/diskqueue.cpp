@@ -0,0 +1,202 @@
+//
+//  diskqueue.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 19/01/22.
+//
+
+#include "diskqueue.h"
+
+using namespace Kernel;
+using namespace pranaOS::ak;
+
+diskQueue::diskQueue(diskQueueDispatch dispatch, void* dispatchContext) {
+    this->dispatch = dispatch;
+    this->dispatchContext = dispatchContext;
+    this->sorted = 0;
+    this->pendingCount = 0;
+    this->headPosition = 0;
+    this->statistics = { 0, 0, 0, 0 };
+
+    this->freeList = 0;
+    for(int i = DISK_QUEUE_DEPTH - 1; i >= 0; i--) {
+        requests[i].next = freeList;
+        freeList = &requests[i];
+    }
+}
+
+diskRequest* diskQueue::submit(uint32_t lba, uint32_t count, uint8_t* buffer, bool write, diskRequestCallback callback, void* context) {
+    if(count == 0)
+        return 0;
+
+    queueLock.lock();
+
+    diskRequest* request = freeList;
+    if(request == 0) {
+        queueLock.unlock();
+        return 0;
+    }
+    freeList = request->next;
+
+    request->lba = lba;
+    request->count = count;
+    request->buffer = buffer;
+    request->write = write;
+    request->result = 0;
+    request->callback = callback;
+    request->context = context;
+    request->deadline = statistics.dispatches + DISK_QUEUE_STARVE_LIMIT;
+
+    // insertion keeps the pending list sorted by lba, so dispatch is a single walk
+    diskRequest** link = &sorted;
+    while(*link && (*link)->lba <= lba)
+        link = &(*link)->next;
+
+    request->next = *link;
+    *link = request;
+
+    pendingCount++;
+    statistics.requests++;
+
+    queueLock.unlock();
+    return request;
+}
+
+/**
+ * @brief unlinks the next C-LOOK request plus the adjacent ones that can ride along with it,
+ * returns the first request of the batch, the batch stays linked through next
+ */
+diskRequest* diskQueue::takeBatch(diskRequest** batch) {
+    diskRequest** link = &sorted;
+    diskRequest** expired = 0;
+
+    for(diskRequest** scan = &sorted; *scan; scan = &(*scan)->next) {
+        if((int32_t)((*scan)->deadline - statistics.dispatches) <= 0 && (expired == 0 || (int32_t)((*scan)->deadline - (*expired)->deadline) < 0))
+            expired = scan;
+    }
+
+    if(expired)
+        link = expired;
+    else {
+        while(*link && (*link)->lba < headPosition)
+            link = &(*link)->next;
+
+        // nothing left ahead of the head, sweep back to the lowest lba
+        if(*link == 0)
+            link = &sorted;
+    }
+
+    diskRequest* first = *link;
+    if(first == 0)
+        return 0;
+
+    diskRequest* last = first;
+    uint32_t sectors = first->count;
+    uint32_t vectors = 1;
+
+    while(last->next) {
+        diskRequest* candidate = last->next;
+        if(candidate->write != first->write || candidate->lba != last->lba + last->count)
+            break;
+        if(sectors + candidate->count > DISK_QUEUE_MAX_SECTORS || vectors == DISK_QUEUE_MAX_VECTORS)
+            break;
+
+        sectors += candidate->count;
+        vectors++;
+        last = candidate;
+    }
+
+    *link = last->next;
+    last->next = 0;
+
+    *batch = first;
+    return first;
+}
+
+uint32_t diskQueue::process(uint32_t maxDispatches) {
+    if(!dispatchLock.tryLock())
+        return 0;
+
+    uint32_t dispatched = 0;
+    diskIoVec vectors[DISK_QUEUE_MAX_VECTORS];
+
+    while(dispatched < maxDispatches) {
+        queueLock.lock();
+        diskRequest* batch = 0;
+        if(takeBatch(&batch) == 0) {
+            queueLock.unlock();
+            break;
+        }
+
+        uint32_t vectorCount = 0;
+        uint32_t sectors = 0;
+        for(diskRequest* r = batch; r; r = r->next) {
+            vectors[vectorCount].buffer = r->buffer;
+            vectors[vectorCount].length = r->count * DISK_SECTOR_SIZE;
+            vectorCount++;
+            sectors += r->count;
+        }
+
+        headPosition = batch->lba + sectors;
+        statistics.dispatches++;
+        statistics.merged += vectorCount - 1;
+        statistics.sectors += sectors;
+        queueLock.unlock();
+
+        char result = dispatch(dispatchContext, batch->lba, sectors, vectors, vectorCount, batch->write);
+        dispatched++;
+
+        diskRequest* r = batch;
+        while(r) {
+            diskRequest* next = r->next;
+            r->result = result;
+            if(r->callback)
+                r->callback(r, r->context);
+
+            queueLock.lock();
+            r->next = freeList;
+            freeList = r;
+            pendingCount--;
+            queueLock.unlock();
+
+            r = next;
+        }
+    }
+
+    dispatchLock.unlock();
+    return dispatched;
+}
+
+struct diskWaiter {
+    volatile bool done;
+    char result;
+};
+
+static void completeWaiter(diskRequest* request, void* context) {
+    diskWaiter* waiter = (diskWaiter*)context;
+    waiter->result = request->result;
+    waiter->done = true;
+}
+
+char diskQueue::transfer(uint32_t lba, uint32_t count, uint8_t* buffer, bool write) {
+    diskWaiter waiter = { false, 0 };
+
+    while(submit(lba, count, buffer, write, completeWaiter, &waiter) == 0)
+        process(1);
+
+    // whoever holds the dispatch lock will complete us, otherwise drive the queue ourselves
+    while(!waiter.done) {
+        if(process() == 0)
+            asm volatile ("pause");
+    }
+
+    return waiter.result;
+}
+
+uint32_t diskQueue::pending() {
+    return pendingCount;
+}
+
+diskQueueStatistics diskQueue::getStatistics() {
+    return statistics;
+}
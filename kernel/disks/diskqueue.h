@@ -0,0 +1,101 @@
+//
+//  diskqueue.h
+//  pranaOS
+//
+//  Created by Krisna Pranav on 19/01/22.
+//
+
+#pragma once
+
+#include <ak/types.h>
+#include <tasking/lock.h>
+#include "diskio.h"
+
+namespace Kernel {
+    #define DISK_QUEUE_DEPTH 64
+    #define DISK_QUEUE_MAX_SECTORS 256
+    #define DISK_QUEUE_MAX_VECTORS 64
+    #define DISK_QUEUE_STARVE_LIMIT 32
+
+    struct diskRequest;
+
+    typedef void (*diskRequestCallback)(diskRequest* request, void* context);
+
+    /**
+     * @brief performs one merged transfer, normally disk::readSectors or disk::writeSectors
+     */
+    typedef char (*diskQueueDispatch)(void* context, ak::uint32_t lba, ak::uint32_t count, diskIoVec* vectors, ak::uint32_t vectorCount, bool write);
+
+    struct diskRequest {
+        ak::uint32_t lba;
+        ak::uint32_t count;
+        ak::uint8_t* buffer;
+        bool write;
+        char result;
+
+        diskRequestCallback callback;
+        void* context;
+
+        /**
+         * @brief dispatch count after which this request is served regardless of the sweep
+         */
+        ak::uint32_t deadline;
+        diskRequest* next;
+    };
+
+    struct diskQueueStatistics {
+        ak::uint32_t requests;
+        ak::uint32_t dispatches;
+        ak::uint32_t merged;
+        ak::uint32_t sectors;
+    };
+
+    /**
+     * @brief per disk request queue. Pending requests are kept sorted by lba and dispatched
+     * in C-LOOK order (ascending from the last position, then wrapping to the lowest lba),
+     * adjacent requests in the same direction are merged into one scatter-gather transfer.
+     * A request passed over for DISK_QUEUE_STARVE_LIMIT dispatches is served next, so a
+     * reader streaming right behind the head cannot starve the others.
+     * Not for interrupt context, completions run from process().
+     */
+    class diskQueue {
+    public:
+        diskQueue(diskQueueDispatch dispatch, void* dispatchContext);
+
+        /**
+         * @brief queues a transfer and returns right away, 0 when the queue is full.
+         * The callback runs once the transfer is done, the request is recycled after it returns.
+         */
+        diskRequest* submit(ak::uint32_t lba, ak::uint32_t count, ak::uint8_t* buffer, bool write, diskRequestCallback callback, void* context);
+
+        /**
+         * @brief dispatches up to maxDispatches merged transfers, returns how many were issued
+         */
+        ak::uint32_t process(ak::uint32_t maxDispatches = 0xFFFFFFFF);
+
+        /**
+         * @brief submit and keep processing until this transfer is done. The caller blocks, so on its
+         * own this keeps the queue depth at 1, sorting and merging only pay off against requests
+         * other callers queued with submit
+         */
+        char transfer(ak::uint32_t lba, ak::uint32_t count, ak::uint8_t* buffer, bool write);
+
+        ak::uint32_t pending();
+        diskQueueStatistics getStatistics();
+
+    private:
+        diskRequest requests[DISK_QUEUE_DEPTH];
+        diskRequest* freeList;
+        diskRequest* sorted;
+        ak::uint32_t pendingCount;
+        ak::uint32_t headPosition;
+
+        diskQueueDispatch dispatch;
+        void* dispatchContext;
+        spinLock queueLock;
+        spinLock dispatchLock;
+        diskQueueStatistics statistics;
+
+        diskRequest* takeBatch(diskRequest** batch);
+    };
+}
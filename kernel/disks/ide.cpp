@@ -0,0 +1,576 @@
+//
+//  ide.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 18/01/22.
+//
+
+#include "ide.h"
+#include "disk.h"
+#include <cpu/port.h>
+#include <cpu/memory.h>
+#include <cpu/paging.h>
+#include <system/pci.h>
+#include <system/log.h>
+
+using namespace Kernel;
+using namespace Kernel::core;
+using namespace Kernel::system;
+using namespace pranaOS;
+using namespace pranaOS::ak;
+
+#define ATA_TIMEOUT 100000
+
+// a few seconds on any cpu fast enough to have bus master ide
+#define ATA_DMA_TIMEOUT_CYCLES 0x200000000ULL
+
+ideInterruptHandler::ideInterruptHandler(ideChannel* channel, uint8_t interrupt)
+: system::interruptHandler(interrupt) {
+    this->channel = channel;
+}
+
+uint32_t ideInterruptHandler::handleInterrupt(uint32_t esp) {
+    uint16_t bm = channel->busMaster;
+    uint8_t status = inportb(bm + BM_REG_STATUS);
+    if(!(status & BM_SR_IRQ))
+        return esp;
+
+    // acknowledge both the drive and the bus master, pio commands end up here as well
+    inportb(channel->base + ATA_REG_STATUS);
+    outportb(bm + BM_REG_STATUS, status | BM_SR_ERR | BM_SR_IRQ);
+
+    if(channel->dmaActive) {
+        channel->dmaStatus = status;
+        channel->dmaDone = true;
+        channel->completion.wake();
+    }
+
+    return esp;
+}
+
+ideController::ideController()
+: diskController() {
+    for(int i = 0; i < 4; i++) {
+        drives[i].present = false;
+        drives[i].dma = false;
+        drives[i].dmaErrors = 0;
+    }
+
+    for(int i = 0; i < 2; i++) {
+        channels[i].base = i == 0 ? IDE_PRIMARY_BASE : IDE_SECONDARY_BASE;
+        channels[i].control = i == 0 ? IDE_PRIMARY_CONTROL : IDE_SECONDARY_CONTROL;
+        channels[i].busMaster = 0;
+        channels[i].dmaActive = false;
+        channels[i].dmaDone = false;
+    }
+}
+
+void ideController::initialize(diskManager* manager) {
+    for(uint8_t i = 0; i < 4; i++) {
+        drives[i].base = i < 2 ? IDE_PRIMARY_BASE : IDE_SECONDARY_BASE;
+        drives[i].control = i < 2 ? IDE_PRIMARY_CONTROL : IDE_SECONDARY_CONTROL;
+        drives[i].slave = i & 1;
+
+        // polled until initializeDma hands a channel over to its irq handler
+        outportb(drives[i].control, ATA_CONTROL_NIEN);
+
+        if(!identify(i))
+            continue;
+
+        disk* device = new disk(i, this, hardDisk, (uint64_t)drives[i].sectors * DISK_SECTOR_SIZE, drives[i].sectors, DISK_SECTOR_SIZE);
+        manager->addDisk(device);
+    }
+
+    initializeDma();
+}
+
+/**
+ * @brief looks for a bus master capable pci ide function and gives every channel
+ * with a dma capable drive its prd table, bounce buffer and irq handler
+ */
+void ideController::initializeDma() {
+    pciDevice ide;
+    if(!pciBus::findDevice(0x01, 0x01, &ide) || !(ide.progIf & 0x80))
+        return;
+
+    uint32_t bar4 = pciBus::read(ide.bus, ide.device, ide.function, PCI_REG_BAR0 + 16);
+    if(!(bar4 & 1))
+        return;
+
+    uint32_t command = pciBus::read(ide.bus, ide.device, ide.function, PCI_REG_COMMAND);
+    pciBus::write(ide.bus, ide.device, ide.function, PCI_REG_COMMAND, command | PCI_COMMAND_IO | PCI_COMMAND_BUS_MASTER);
+
+    for(uint8_t c = 0; c < 2; c++) {
+        if(!drives[c * 2].dma && !drives[c * 2 + 1].dma)
+            continue;
+
+        ideChannel* channel = &channels[c];
+        void* prd = physicalMemoryManager::allocateBlocks(1);
+        void* buffer = physicalMemoryManager::allocateBlocks(IDE_DMA_BUFFER_BLOCKS);
+
+        // the frames can sit anywhere in physical memory, give them a kernel mapping of their own
+        uint32_t prdVirtual = prd ? virtualMemoryManager::mapPhysical((uint32_t)prd, PAGE_SIZE) : 0;
+        uint32_t bufferVirtual = buffer ? virtualMemoryManager::mapPhysical((uint32_t)buffer, IDE_DMA_BUFFER_BLOCKS * PAGE_SIZE) : 0;
+        if(prdVirtual == 0 || bufferVirtual == 0) {
+            if(prdVirtual)
+                virtualMemoryManager::unmapPage(prdVirtual);
+            for(uint32_t i = 0; bufferVirtual && i < IDE_DMA_BUFFER_BLOCKS; i++)
+                virtualMemoryManager::unmapPage(bufferVirtual + i * PAGE_SIZE);
+            if(prd)
+                physicalMemoryManager::freeBlocks(prd, 1);
+            if(buffer)
+                physicalMemoryManager::freeBlocks(buffer, IDE_DMA_BUFFER_BLOCKS);
+            log(Warning, "ide: no dma memory for channel %d", c);
+            continue;
+        }
+
+        channel->prdPhysical = (uint32_t)prd;
+        channel->prdTable = (prdEntry*)prdVirtual;
+        channel->bufferPhysical = (uint32_t)buffer;
+        channel->buffer = (uint8_t*)bufferVirtual;
+        channel->busMaster = (bar4 & 0xFFFC) + c * 8;
+
+        new ideInterruptHandler(channel, c == 0 ? IDE_PRIMARY_INTERRUPT : IDE_SECONDARY_INTERRUPT);
+
+        // completion is interrupt driven from here on, clear nIEN
+        outportb(channel->control, 0x00);
+    }
+}
+
+bool ideController::waitReady(ideDrive* drive) {
+    for(int i = 0; i < ATA_TIMEOUT; i++) {
+        if(!(inportb(drive->base + ATA_REG_STATUS) & ATA_SR_BSY))
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief waits until the drive has the next DRQ block ready, 0 on success
+ */
+char ideController::waitData(ideDrive* drive) {
+    // reading the alternate status four times gives the drive its 400ns to update
+    for(int i = 0; i < 4; i++)
+        inportb(drive->control);
+
+    for(int i = 0; i < ATA_TIMEOUT; i++) {
+        uint8_t status = inportb(drive->base + ATA_REG_STATUS);
+        if(status & ATA_SR_BSY)
+            continue;
+        if(status & (ATA_SR_ERR | ATA_SR_DF))
+            return 1;
+        if(status & ATA_SR_DRQ)
+            return 0;
+    }
+
+    return 1;
+}
+
+bool ideController::identify(uint8_t index) {
+    ideDrive* drive = &drives[index];
+    uint16_t data[256];
+
+    outportb(drive->base + ATA_REG_DRIVE, drive->slave ? 0xB0 : 0xA0);
+    outportb(drive->base + ATA_REG_SECCOUNT, 0);
+    outportb(drive->base + ATA_REG_LBA0, 0);
+    outportb(drive->base + ATA_REG_LBA1, 0);
+    outportb(drive->base + ATA_REG_LBA2, 0);
+    outportb(drive->base + ATA_REG_COMMAND, ATA_CMD_IDENTIFY);
+
+    if(inportb(drive->base + ATA_REG_STATUS) == 0 || !waitReady(drive))
+        return false;
+
+    // atapi and sata devices report a signature here instead of identify data
+    if(inportb(drive->base + ATA_REG_LBA1) != 0 || inportb(drive->base + ATA_REG_LBA2) != 0)
+        return false;
+
+    if(waitData(drive) != 0)
+        return false;
+
+    inportsm(drive->base + ATA_REG_DATA, (uint8_t*)data, 256);
+
+    drive->sectors = data[60] | ((uint32_t)data[61] << 16);
+    drive->multipleCount = 0;
+    drive->unflushed = false;
+    drive->present = drive->sectors != 0;
+
+    // word 49 bit 8, the drive implements the dma data transfer commands
+    drive->dma = drive->present && (data[49] & 0x100);
+
+    // word 47 holds the largest DRQ block the drive supports for READ/WRITE MULTIPLE
+    uint8_t maxMultiple = data[47] & 0xFF;
+    if(drive->present && maxMultiple > 0)
+        setMultiple(drive, maxMultiple);
+
+    return drive->present;
+}
+
+void ideController::setMultiple(ideDrive* drive, uint8_t count) {
+    drive->multipleCount = 0;
+
+    outportb(drive->base + ATA_REG_DRIVE, drive->slave ? 0xB0 : 0xA0);
+    outportb(drive->base + ATA_REG_SECCOUNT, count);
+    outportb(drive->base + ATA_REG_COMMAND, ATA_CMD_SET_MULTIPLE);
+
+    if(waitReady(drive) && !(inportb(drive->base + ATA_REG_STATUS) & ATA_SR_ERR))
+        drive->multipleCount = count;
+}
+
+/**
+ * @brief stops the bus master and soft resets both drives of a channel after a dma command hung,
+ * the drives may drop their READ/WRITE MULTIPLE block size so it is set again
+ */
+void ideController::resetChannel(uint8_t index) {
+    ideChannel* channel = &channels[index];
+    uint16_t bm = channel->busMaster;
+
+    outportb(bm + BM_REG_COMMAND, 0);
+    outportb(bm + BM_REG_STATUS, inportb(bm + BM_REG_STATUS) | BM_SR_ERR | BM_SR_IRQ);
+
+    // SRST has to stay set for at least 5us, every alternate status read takes about 400ns
+    outportb(channel->control, ATA_CONTROL_SRST | ATA_CONTROL_NIEN);
+    for(int i = 0; i < 16; i++)
+        inportb(channel->control);
+    outportb(channel->control, 0x00);
+
+    for(int i = 0; i < 2; i++) {
+        ideDrive* drive = &drives[index * 2 + i];
+        if(!drive->present)
+            continue;
+
+        waitReady(drive);
+        if(drive->multipleCount)
+            setMultiple(drive, drive->multipleCount);
+    }
+}
+
+void ideController::selectLba(ideDrive* drive, uint32_t lba, uint32_t count) {
+    outportb(drive->base + ATA_REG_DRIVE, (drive->slave ? 0xF0 : 0xE0) | ((lba >> 24) & 0x0F));
+    outportb(drive->base + ATA_REG_SECCOUNT, count == ATA_MAX_SECTORS_PER_COMMAND ? 0 : count);
+    outportb(drive->base + ATA_REG_LBA0, lba & 0xFF);
+    outportb(drive->base + ATA_REG_LBA1, (lba >> 8) & 0xFF);
+    outportb(drive->base + ATA_REG_LBA2, (lba >> 16) & 0xFF);
+}
+
+uint8_t* ideCursor::nextSector() {
+    while(vector < vectorCount && offset >= vectors[vector].length) {
+        vector++;
+        offset = 0;
+    }
+
+    if(vector >= vectorCount)
+        return 0;
+
+    uint8_t* sector = vectors[vector].buffer + offset;
+    offset += DISK_SECTOR_SIZE;
+    return sector;
+}
+
+/**
+ * @brief one command, one status wait per DRQ block and a rep insw/outsw burst
+ * per sector straight into the caller's vectors
+ */
+char ideController::pioTransfer(ideDrive* drive, uint32_t lba, uint32_t count, ideCursor* cursor, bool write) {
+    uint32_t block = drive->multipleCount ? drive->multipleCount : 1;
+
+    if(!waitReady(drive))
+        return 1;
+
+    selectLba(drive, lba, count);
+    if(drive->multipleCount)
+        outportb(drive->base + ATA_REG_COMMAND, write ? ATA_CMD_WRITE_MULTIPLE : ATA_CMD_READ_MULTIPLE);
+    else
+        outportb(drive->base + ATA_REG_COMMAND, write ? ATA_CMD_WRITE_PIO : ATA_CMD_READ_PIO);
+
+    for(uint32_t done = 0; done < count; ) {
+        if(waitData(drive) != 0)
+            return 1;
+
+        uint32_t sectors = count - done < block ? count - done : block;
+        for(uint32_t s = 0; s < sectors; s++) {
+            uint8_t* buffer = cursor->nextSector();
+            if(buffer == 0)
+                return 1;
+
+            if(write)
+                outportsm(drive->base + ATA_REG_DATA, buffer, DISK_SECTOR_SIZE / 2);
+            else
+                inportsm(drive->base + ATA_REG_DATA, buffer, DISK_SECTOR_SIZE / 2);
+        }
+
+        done += sectors;
+    }
+
+    // a write only ends once the drive has taken the last block, an error there shows up nowhere else
+    if(write) {
+        for(int i = 0; i < 4; i++)
+            inportb(drive->control);
+
+        if(!waitReady(drive) || (inportb(drive->base + ATA_REG_STATUS) & (ATA_SR_ERR | ATA_SR_DF)))
+            return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief points the prd table straight at the caller's buffers, false when a sector is not word
+ * aligned or not mapped, or the table runs out of entries. cursor only moves on success
+ */
+bool ideController::buildPrd(ideChannel* channel, ideCursor* cursor, uint32_t count) {
+    ideCursor walk = *cursor;
+    uint32_t entries = 0;
+    uint32_t start = 0;
+    uint32_t length = 0;
+
+    for(uint32_t s = 0; s < count; s++) {
+        uint8_t* sector = walk.nextSector();
+        if(sector == 0 || ((uint32_t)sector & 1))
+            return false;
+
+        for(uint32_t done = 0; done < DISK_SECTOR_SIZE; ) {
+            uint32_t address = (uint32_t)sector + done;
+            uint32_t physical = virtualMemoryManager::getPhysical(address);
+            if(physical == 0)
+                return false;
+
+            uint32_t piece = PAGE_SIZE - (address & (PAGE_SIZE - 1));
+            if(piece > DISK_SECTOR_SIZE - done)
+                piece = DISK_SECTOR_SIZE - done;
+
+            // grow the open entry while memory stays contiguous, an entry may not cross a 64 KB boundary
+            if(length && physical == start + length && (start >> 16) == ((physical + piece - 1) >> 16)) {
+                length += piece;
+            } else {
+                if(length) {
+                    if(entries == IDE_PRD_ENTRIES)
+                        return false;
+
+                    channel->prdTable[entries].address = start;
+                    channel->prdTable[entries].byteCount = length & 0xFFFF;
+                    channel->prdTable[entries].flags = 0;
+                    entries++;
+                }
+
+                start = physical;
+                length = piece;
+            }
+
+            done += piece;
+        }
+    }
+
+    if(entries == IDE_PRD_ENTRIES)
+        return false;
+
+    channel->prdTable[entries].address = start;
+    channel->prdTable[entries].byteCount = length & 0xFFFF;
+    channel->prdTable[entries].flags = PRD_END_OF_TABLE;
+
+    *cursor = walk;
+    return true;
+}
+
+void ideController::buildBouncePrd(ideChannel* channel, uint32_t count) {
+    // the buffer frames are contiguous but not 64 KB aligned, so it can need two entries
+    uint32_t entry = 0;
+    uint32_t address = channel->bufferPhysical;
+    for(uint32_t remaining = count * DISK_SECTOR_SIZE; remaining > 0; entry++) {
+        uint32_t chunk = 0x10000 - (address & 0xFFFF);
+        if(chunk > remaining)
+            chunk = remaining;
+
+        channel->prdTable[entry].address = address;
+        channel->prdTable[entry].byteCount = chunk & 0xFFFF;
+        channel->prdTable[entry].flags = 0;
+
+        address += chunk;
+        remaining -= chunk;
+    }
+    channel->prdTable[entry - 1].flags = PRD_END_OF_TABLE;
+}
+
+/**
+ * @brief sleeps on the channel until the irq handler reports the command done, false on timeout.
+ * Callers running with interrupts off poll the bus master status instead. The timeout is only
+ * noticed on a wakeup, so a lost irq relies on some other interrupt (the timer) to end the halt
+ */
+bool ideController::waitDma(ideChannel* channel) {
+    uint64_t start = Cpu::readTimestamp();
+
+    while(!channel->dmaDone) {
+        if(Cpu::readTimestamp() - start > ATA_DMA_TIMEOUT_CYCLES)
+            return false;
+
+        if(!Cpu::interruptsEnabled()) {
+            uint8_t status = inportb(channel->busMaster + BM_REG_STATUS);
+            if(status & BM_SR_IRQ) {
+                inportb(channel->base + ATA_REG_STATUS);
+                outportb(channel->busMaster + BM_REG_STATUS, status | BM_SR_ERR | BM_SR_IRQ);
+                channel->dmaStatus = status;
+                channel->dmaDone = true;
+            }
+            continue;
+        }
+
+        uint32_t ticket = channel->completion.prepare();
+        if(!channel->dmaDone)
+            channel->completion.wait(ticket);
+    }
+
+    return true;
+}
+
+/**
+ * @brief moves count sectors with one dma command, straight from the caller's buffers when
+ * buildPrd can map them and through the channel's bounce buffer otherwise
+ */
+char ideController::dmaTransfer(ideDrive* drive, ideChannel* channel, uint32_t lba, uint32_t count, ideCursor* cursor, bool write) {
+    ideCursor bounce = *cursor;
+    bool direct = buildPrd(channel, cursor, count);
+
+    if(!direct) {
+        if(write) {
+            for(uint32_t s = 0; s < count; s++) {
+                uint8_t* sector = cursor->nextSector();
+                if(sector == 0)
+                    return 1;
+                ::ak::memOperator::memcpy(channel->buffer + s * DISK_SECTOR_SIZE, sector, DISK_SECTOR_SIZE);
+            }
+        }
+
+        buildBouncePrd(channel, count);
+    }
+
+    uint16_t bm = channel->busMaster;
+    outportb(bm + BM_REG_COMMAND, write ? 0 : BM_CMD_READ);
+    outportl(bm + BM_REG_PRDT, channel->prdPhysical);
+    outportb(bm + BM_REG_STATUS, inportb(bm + BM_REG_STATUS) | BM_SR_ERR | BM_SR_IRQ);
+
+    if(!waitReady(drive))
+        return 1;
+
+    channel->dmaDone = false;
+    channel->dmaStatus = 0;
+    channel->dmaActive = true;
+
+    selectLba(drive, lba, count);
+    outportb(drive->base + ATA_REG_COMMAND, write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA);
+    outportb(bm + BM_REG_COMMAND, (write ? 0 : BM_CMD_READ) | BM_CMD_START);
+
+    bool completed = waitDma(channel);
+
+    outportb(bm + BM_REG_COMMAND, 0);
+    channel->dmaActive = false;
+
+    if(!completed || (channel->dmaStatus & BM_SR_ERR))
+        return 1;
+    if(inportb(drive->base + ATA_REG_STATUS) & (ATA_SR_ERR | ATA_SR_DF))
+        return 1;
+
+    if(!direct && !write) {
+        for(uint32_t s = 0; s < count; s++) {
+            uint8_t* sector = bounce.nextSector();
+            if(sector == 0)
+                return 1;
+            ::ak::memOperator::memcpy(sector, channel->buffer + s * DISK_SECTOR_SIZE, DISK_SECTOR_SIZE);
+        }
+        *cursor = bounce;
+    }
+
+    return 0;
+}
+
+char ideController::transfer(uint16_t index, uint32_t lba, uint32_t count, diskIoVec* vectors, uint32_t vectorCount, bool write) {
+    if(index >= 4 || !drives[index].present || lba + count > drives[index].sectors)
+        return 1;
+
+    ideDrive* drive = &drives[index];
+    ideChannel* channel = &channels[index / 2];
+    ideCursor cursor = { vectors, vectorCount, 0, 0 };
+    char result = 0;
+
+    channel->lock.lock();
+
+    while(count > 0 && result == 0) {
+        uint32_t chunk;
+
+        if(drive->dma && channel->busMaster) {
+            chunk = count < IDE_DMA_MAX_SECTORS ? count : IDE_DMA_MAX_SECTORS;
+
+            ideCursor start = cursor;
+            if(dmaTransfer(drive, channel, lba, chunk, &cursor, write) == 0) {
+                drive->dmaErrors = 0;
+                lba += chunk;
+                count -= chunk;
+                continue;
+            }
+
+            // the command may still be running, reset the channel and redo this chunk with pio
+            resetChannel(index / 2);
+            cursor = start;
+
+            if(++drive->dmaErrors < IDE_DMA_MAX_ERRORS) {
+                log(Warning, "ide: dma failed on drive %d, channel reset", index);
+            } else {
+                log(Warning, "ide: dma failed on drive %d, falling back to pio", index);
+                drive->dma = false;
+            }
+        }
+
+        chunk = count < ATA_MAX_SECTORS_PER_COMMAND ? count : ATA_MAX_SECTORS_PER_COMMAND;
+        result = pioTransfer(drive, lba, chunk, &cursor, write);
+
+        lba += chunk;
+        count -= chunk;
+    }
+
+    if(write && result == 0)
+        drive->unflushed = true;
+
+    channel->lock.unlock();
+    return result;
+}
+
+char ideController::flushCache(uint16_t index) {
+    if(index >= 4 || !drives[index].present)
+        return 1;
+
+    ideDrive* drive = &drives[index];
+    ideChannel* channel = &channels[index / 2];
+    char result = 0;
+
+    channel->lock.lock();
+
+    if(drive->unflushed) {
+        outportb(drive->base + ATA_REG_DRIVE, drive->slave ? 0xF0 : 0xE0);
+        outportb(drive->base + ATA_REG_COMMAND, ATA_CMD_CACHE_FLUSH);
+
+        if(!waitReady(drive) || (inportb(drive->base + ATA_REG_STATUS) & (ATA_SR_ERR | ATA_SR_DF)))
+            result = 1;
+        else
+            drive->unflushed = false;
+    }
+
+    channel->lock.unlock();
+    return result;
+}
+
+char ideController::readSector(uint16_t drive, uint32_t lba, uint8_t* buf) {
+    diskIoVec vector = { buf, DISK_SECTOR_SIZE };
+    return transfer(drive, lba, 1, &vector, 1, false);
+}
+
+char ideController::writeSector(uint16_t drive, uint32_t lba, uint8_t* buf) {
+    diskIoVec vector = { buf, DISK_SECTOR_SIZE };
+    return transfer(drive, lba, 1, &vector, 1, true);
+}
+
+char ideController::readSectors(uint16_t drive, uint32_t lba, uint32_t count, diskIoVec* vectors, uint32_t vectorCount) {
+    return transfer(drive, lba, count, vectors, vectorCount, false);
+}
+
+char ideController::writeSectors(uint16_t drive, uint32_t lba, uint32_t count, diskIoVec* vectors, uint32_t vectorCount) {
+    return transfer(drive, lba, count, vectors, vectorCount, true);
+}
@@ -0,0 +1,185 @@
+//
+//  ide.h
+//  pranaOS
+//
+//  Created by Krisna Pranav on 18/01/22.
+//
+
+#pragma once
+
+#include <ak/types.h>
+#include <tasking/lock.h>
+#include <system/interrupthandler.h>
+#include "diskcontroller.h"
+#include "diskmanager.h"
+
+namespace Kernel {
+    #define IDE_PRIMARY_BASE 0x1F0
+    #define IDE_PRIMARY_CONTROL 0x3F6
+    #define IDE_SECONDARY_BASE 0x170
+    #define IDE_SECONDARY_CONTROL 0x376
+
+    #define IDE_PRIMARY_INTERRUPT 0x2E
+    #define IDE_SECONDARY_INTERRUPT 0x2F
+
+    #define ATA_REG_DATA 0
+    #define ATA_REG_ERROR 1
+    #define ATA_REG_SECCOUNT 2
+    #define ATA_REG_LBA0 3
+    #define ATA_REG_LBA1 4
+    #define ATA_REG_LBA2 5
+    #define ATA_REG_DRIVE 6
+    #define ATA_REG_STATUS 7
+    #define ATA_REG_COMMAND 7
+
+    #define ATA_SR_ERR 0x01
+    #define ATA_SR_DRQ 0x08
+    #define ATA_SR_DF 0x20
+    #define ATA_SR_BSY 0x80
+
+    #define ATA_CMD_READ_PIO 0x20
+    #define ATA_CMD_WRITE_PIO 0x30
+    #define ATA_CMD_READ_MULTIPLE 0xC4
+    #define ATA_CMD_WRITE_MULTIPLE 0xC5
+    #define ATA_CMD_SET_MULTIPLE 0xC6
+    #define ATA_CMD_READ_DMA 0xC8
+    #define ATA_CMD_WRITE_DMA 0xCA
+    #define ATA_CMD_CACHE_FLUSH 0xE7
+    #define ATA_CMD_IDENTIFY 0xEC
+
+    #define ATA_MAX_SECTORS_PER_COMMAND 256
+
+    #define BM_REG_COMMAND 0
+    #define BM_REG_STATUS 2
+    #define BM_REG_PRDT 4
+
+    #define BM_CMD_START 0x01
+    #define BM_CMD_READ 0x08
+    #define BM_SR_ERR 0x02
+    #define BM_SR_IRQ 0x04
+
+    #define PRD_END_OF_TABLE 0x8000
+
+    #define ATA_CONTROL_NIEN 0x02
+    #define ATA_CONTROL_SRST 0x04
+
+    /**
+     * @brief 64 KB bounce buffer per channel for callers whose buffers the prd table cannot
+     * point at, one dma command moves at most this much
+     */
+    #define IDE_DMA_BUFFER_BLOCKS 16
+    #define IDE_DMA_MAX_SECTORS (IDE_DMA_BUFFER_BLOCKS * 4096 / DISK_SECTOR_SIZE)
+    #define IDE_PRD_ENTRIES (4096 / sizeof(prdEntry))
+
+    /**
+     * @brief failed dma commands in a row after which a drive stays on pio
+     */
+    #define IDE_DMA_MAX_ERRORS 3
+
+    struct prdEntry {
+        ak::uint32_t address;
+        ak::uint16_t byteCount;
+        ak::uint16_t flags;
+    } __attribute__((packed));
+
+    struct ideDrive {
+        bool present;
+        ak::uint16_t base;
+        ak::uint16_t control;
+        bool slave;
+        ak::uint32_t sectors;
+
+        /**
+         * @brief sectors per DRQ block for READ/WRITE MULTIPLE, 0 when the drive lacks them
+         */
+        ak::uint8_t multipleCount;
+        bool dma;
+        ak::uint8_t dmaErrors;
+
+        /**
+         * @brief writes completed since the last CACHE FLUSH
+         */
+        bool unflushed;
+    };
+
+    /**
+     * @brief bus master state of one channel, busMaster is 0 when the channel runs pio only
+     */
+    struct ideChannel {
+        ak::uint16_t base;
+        ak::uint16_t control;
+        ak::uint16_t busMaster;
+        prdEntry* prdTable;
+        ak::uint32_t prdPhysical;
+        ak::uint8_t* buffer;
+        ak::uint32_t bufferPhysical;
+
+        volatile bool dmaActive;
+        volatile bool dmaDone;
+        volatile ak::uint8_t dmaStatus;
+        waitQueue completion;
+        mutexLock lock;
+    };
+
+    /**
+     * @brief walks the caller's scatter-gather list one sector at a time
+     */
+    struct ideCursor {
+        diskIoVec* vectors;
+        ak::uint32_t vectorCount;
+        ak::uint32_t vector;
+        ak::uint32_t offset;
+
+        ak::uint8_t* nextSector();
+    };
+
+    class ideController;
+
+    class ideInterruptHandler : public system::interruptHandler {
+    public:
+        ideInterruptHandler(ideChannel* channel, ak::uint8_t interrupt);
+        ak::uint32_t handleInterrupt(ak::uint32_t esp);
+
+    private:
+        ideChannel* channel;
+    };
+
+    /**
+     * @brief ata controller for the two legacy channels (drive 0..3). Uses pci bus master dma
+     * when the ide function and the drive support it, straight into the caller's buffers or through
+     * a bounce buffer when they are not word aligned. Otherwise pio with one READ/WRITE MULTIPLE
+     * command per 256 sectors
+     */
+    class ideController : public diskController {
+    public:
+        ideController();
+
+        void initialize(diskManager* manager);
+
+        char readSector(ak::uint16_t drive, ak::uint32_t lba, ak::uint8_t* buf);
+        char writeSector(ak::uint16_t drive, ak::uint32_t lba, ak::uint8_t* buf);
+
+        char readSectors(ak::uint16_t drive, ak::uint32_t lba, ak::uint32_t count, diskIoVec* vectors, ak::uint32_t vectorCount);
+        char writeSectors(ak::uint16_t drive, ak::uint32_t lba, ak::uint32_t count, diskIoVec* vectors, ak::uint32_t vectorCount);
+        char flushCache(ak::uint16_t drive);
+
+    private:
+        ideDrive drives[4];
+        ideChannel channels[2];
+
+        bool identify(ak::uint8_t index);
+        void initializeDma();
+        bool waitReady(ideDrive* drive);
+        void setMultiple(ideDrive* drive, ak::uint8_t count);
+        void resetChannel(ak::uint8_t index);
+        char waitData(ideDrive* drive);
+        void selectLba(ideDrive* drive, ak::uint32_t lba, ak::uint32_t count);
+
+        char pioTransfer(ideDrive* drive, ak::uint32_t lba, ak::uint32_t count, ideCursor* cursor, bool write);
+        bool buildPrd(ideChannel* channel, ideCursor* cursor, ak::uint32_t count);
+        void buildBouncePrd(ideChannel* channel, ak::uint32_t count);
+        bool waitDma(ideChannel* channel);
+        char dmaTransfer(ideDrive* drive, ideChannel* channel, ak::uint32_t lba, ak::uint32_t count, ideCursor* cursor, bool write);
+        char transfer(ak::uint16_t drive, ak::uint32_t lba, ak::uint32_t count, diskIoVec* vectors, ak::uint32_t vectorCount, bool write);
+    };
+}
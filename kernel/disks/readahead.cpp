@@ -0,0 +1,52 @@
+//
+//  readahead.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 20/01/22.
+//
+
+#include "readahead.h"
+#include "diskmanager.h"
+
+using namespace Kernel;
+using namespace pranaOS::ak;
+
+void readAhead::reset(readAheadState* state) {
+    state->nextLba = (uint32_t)-1;
+    state->window = 0;
+    state->prefetchedEnd = 0;
+}
+
+void readAhead::access(diskManager* manager, uint16_t drive, readAheadState* state, uint32_t lba, uint32_t count, uint32_t limit) {
+    uint32_t end = lba + count;
+    bool sequential = lba == state->nextLba;
+    state->nextLba = end;
+
+    if(!sequential) {
+        // random access, drop the window until the reader settles into a stream again
+        state->window = 0;
+        state->prefetchedEnd = end;
+        return;
+    }
+
+    if(state->window == 0)
+        state->window = READAHEAD_MIN_WINDOW;
+    else if(state->window < READAHEAD_MAX_WINDOW)
+        state->window *= 2;
+
+    if(state->prefetchedEnd < end)
+        state->prefetchedEnd = end;
+
+    // still more than half a window buffered ahead of the reader
+    if(state->prefetchedEnd - end > state->window / 2)
+        return;
+
+    uint32_t start = state->prefetchedEnd;
+    uint32_t size = state->window;
+    if(start >= limit)
+        return;
+    if(size > limit - start)
+        size = limit - start;
+
+    state->prefetchedEnd = start + manager->prefetch(drive, start, size);
+}
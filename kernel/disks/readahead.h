@@ -0,0 +1,44 @@
+//
+//  readahead.h
+//  pranaOS
+//
+//  Created by Krisna Pranav on 20/01/22.
+//
+
+#pragma once
+
+#include <ak/types.h>
+
+namespace Kernel {
+    class diskManager;
+
+    #define READAHEAD_MIN_WINDOW 8
+    #define READAHEAD_MAX_WINDOW 64
+
+    /**
+     * @brief sequential access tracking, one per open file
+     */
+    struct readAheadState {
+        ak::uint32_t nextLba;
+        ak::uint32_t window;
+        ak::uint32_t prefetchedEnd;
+    };
+
+    /**
+     * @brief detects sequential reads and keeps the block cache filled ahead of them.
+     * The window starts at READAHEAD_MIN_WINDOW sectors and doubles on every sequential read
+     * up to READAHEAD_MAX_WINDOW, a new window is queued once the reader has consumed half
+     * of the previous one. Queued windows are not dispatched on their own, the first read that
+     * reaches one (or diskManager::processQueues) issues it as a single merged command.
+     */
+    class readAhead {
+    public:
+        static void reset(readAheadState* state);
+
+        /**
+         * @brief called for every read of [lba, lba + count), limit is the first lba past the
+         * file extent so read-ahead never runs off the end of the file
+         */
+        static void access(diskManager* manager, ak::uint16_t drive, readAheadState* state, ak::uint32_t lba, ak::uint32_t count, ak::uint32_t limit);
+    };
+}
@@ -0,0 +1,188 @@
+//
+//  dentrycache.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 21/01/22.
+//
+
+#include "dentrycache.h"
+#include <system/sysinfo.h>
+
+using namespace Kernel;
+using namespace Kernel::system;
+using namespace pranaOS::ak;
+
+dentryEntry dentryCache::entries[DENTRY_CACHE_SIZE];
+uint16_t dentryCache::buckets[DENTRY_CACHE_BUCKETS];
+uint32_t dentryCache::clockHand = 0;
+uint64_t dentryCache::hits = 0;
+uint64_t dentryCache::misses = 0;
+bool dentryCache::registered = false;
+spinLock dentryCache::cacheLock;
+
+uint32_t dentryCache::hashName(uint32_t parent, const char* name, uint32_t nameLength) {
+    // fnv-1a over the parent id and the name
+    uint32_t hash = 2166136261u ^ parent;
+    for(uint32_t i = 0; i < nameLength; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+uint16_t dentryCache::find(uint32_t parent, uint32_t hash, const char* name, uint32_t nameLength) {
+    uint16_t index = buckets[hash % DENTRY_CACHE_BUCKETS];
+
+    while(index != DENTRY_NONE) {
+        dentryEntry* entry = &entries[index];
+        if(entry->hash == hash && entry->parent == parent && entry->nameLength == nameLength) {
+            uint32_t i = 0;
+            while(i < nameLength && entry->name[i] == name[i])
+                i++;
+            if(i == nameLength)
+                return index;
+        }
+        index = entry->next;
+    }
+
+    return DENTRY_NONE;
+}
+
+void dentryCache::unlink(uint16_t index) {
+    dentryEntry* entry = &entries[index];
+    uint16_t* link = &buckets[entry->hash % DENTRY_CACHE_BUCKETS];
+
+    while(*link != DENTRY_NONE) {
+        if(*link == index) {
+            *link = entry->next;
+            break;
+        }
+        link = &entries[*link].next;
+    }
+
+    entry->used = false;
+}
+
+bool dentryCache::lookup(uint32_t parent, const char* name, uint32_t nameLength, vfsInode* result, bool* negative) {
+    if(nameLength > DENTRY_NAME_LENGTH)
+        return false;
+
+    uint32_t hash = hashName(parent, name, nameLength);
+
+    cacheLock.lock();
+    uint16_t index = find(parent, hash, name, nameLength);
+    if(index == DENTRY_NONE) {
+        misses++;
+        cacheLock.unlock();
+        return false;
+    }
+
+    dentryEntry* entry = &entries[index];
+    entry->referenced = true;
+    *negative = entry->negative;
+    if(!entry->negative)
+        *result = entry->inode;
+
+    hits++;
+    cacheLock.unlock();
+    return true;
+}
+
+void dentryCache::insert(uint32_t parent, const char* name, uint32_t nameLength, const vfsInode* inode) {
+    if(nameLength > DENTRY_NAME_LENGTH)
+        return;
+
+    uint32_t hash = hashName(parent, name, nameLength);
+
+    cacheLock.lock();
+
+    uint16_t index = find(parent, hash, name, nameLength);
+    if(index == DENTRY_NONE) {
+        // second chance, skip entries used since the hand last passed them
+        while(true) {
+            dentryEntry* candidate = &entries[clockHand];
+            index = clockHand;
+            clockHand = (clockHand + 1) % DENTRY_CACHE_SIZE;
+
+            if(!candidate->used)
+                break;
+            if(!candidate->referenced) {
+                unlink(index);
+                break;
+            }
+            candidate->referenced = false;
+        }
+
+        dentryEntry* entry = &entries[index];
+        entry->parent = parent;
+        entry->hash = hash;
+        entry->nameLength = nameLength;
+        for(uint32_t i = 0; i < nameLength; i++)
+            entry->name[i] = name[i];
+
+        entry->used = true;
+        entry->next = buckets[hash % DENTRY_CACHE_BUCKETS];
+        buckets[hash % DENTRY_CACHE_BUCKETS] = index;
+    }
+
+    dentryEntry* entry = &entries[index];
+    entry->referenced = false;
+    entry->negative = inode == 0;
+    if(inode)
+        entry->inode = *inode;
+
+    cacheLock.unlock();
+}
+
+void dentryCache::invalidate(uint32_t parent, const char* name, uint32_t nameLength) {
+    if(nameLength > DENTRY_NAME_LENGTH)
+        return;
+
+    uint32_t hash = hashName(parent, name, nameLength);
+
+    cacheLock.lock();
+    uint16_t index = find(parent, hash, name, nameLength);
+    if(index != DENTRY_NONE)
+        unlink(index);
+    cacheLock.unlock();
+}
+
+void dentryCache::update(uint32_t parent, const char* name, uint32_t nameLength, const vfsInode* inode) {
+    if(nameLength > DENTRY_NAME_LENGTH)
+        return;
+
+    uint32_t hash = hashName(parent, name, nameLength);
+
+    cacheLock.lock();
+    uint16_t index = find(parent, hash, name, nameLength);
+    if(index != DENTRY_NONE && !entries[index].negative)
+        entries[index].inode = *inode;
+    cacheLock.unlock();
+}
+
+void dentryCache::clear() {
+    cacheLock.lock();
+    for(uint32_t i = 0; i < DENTRY_CACHE_BUCKETS; i++)
+        buckets[i] = DENTRY_NONE;
+    for(uint32_t i = 0; i < DENTRY_CACHE_SIZE; i++)
+        entries[i].used = false;
+    clockHand = 0;
+    cacheLock.unlock();
+
+    if(!registered)
+        registered = systemInfoManager::registerProvider("dentries", dentryCache::getSysInfoValue);
+}
+
+bool dentryCache::getSysInfoValue(const char* path, uint64_t* value) {
+    if(systemInfoManager::isKey(path, "hits"))
+        *value = hits;
+    else if(systemInfoManager::isKey(path, "misses"))
+        *value = misses;
+    else if(systemInfoManager::isKey(path, "size"))
+        *value = DENTRY_CACHE_SIZE;
+    else
+        return false;
+
+    return true;
+}
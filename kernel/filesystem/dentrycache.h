@@ -0,0 +1,73 @@
+//
+//  dentrycache.h
+//  pranaOS
+//
+//  Created by Krisna Pranav on 21/01/22.
+//
+
+#pragma once
+
+#include <ak/types.h>
+#include <tasking/lock.h>
+#include "vfs.h"
+
+namespace Kernel {
+    #define DENTRY_CACHE_SIZE 256
+    #define DENTRY_CACHE_BUCKETS 64
+    #define DENTRY_NAME_LENGTH 32
+    #define DENTRY_NONE 0xFFFF
+
+    /**
+     * @brief one path component, negative entries remember names that do not exist
+     */
+    struct dentryEntry {
+        ak::uint32_t parent;
+        ak::uint32_t hash;
+        ak::uint8_t nameLength;
+        char name[DENTRY_NAME_LENGTH];
+
+        bool used;
+        bool negative;
+        bool referenced;
+
+        vfsInode inode;
+        ak::uint16_t next;
+    };
+
+    /**
+     * @brief (parent inode, name) -> inode cache used by vfsManager::resolve,
+     * names longer than DENTRY_NAME_LENGTH are never cached, replacement is second chance
+     */
+    class dentryCache {
+    public:
+        static bool lookup(ak::uint32_t parent, const char* name, ak::uint32_t nameLength, vfsInode* result, bool* negative);
+
+        /**
+         * @brief inode 0 inserts a negative entry
+         */
+        static void insert(ak::uint32_t parent, const char* name, ak::uint32_t nameLength, const vfsInode* inode);
+        static void invalidate(ak::uint32_t parent, const char* name, ak::uint32_t nameLength);
+
+        /**
+         * @brief refreshes the entry of a file whose inode changed, does not insert one.
+         * Keyed by name since the id itself can change (an empty file gets one on its first write)
+         */
+        static void update(ak::uint32_t parent, const char* name, ak::uint32_t nameLength, const vfsInode* inode);
+        static void clear();
+
+    private:
+        static dentryEntry entries[DENTRY_CACHE_SIZE];
+        static ak::uint16_t buckets[DENTRY_CACHE_BUCKETS];
+        static ak::uint32_t clockHand;
+        static ak::uint64_t hits;
+        static ak::uint64_t misses;
+        static bool registered;
+        static spinLock cacheLock;
+
+        static ak::uint32_t hashName(ak::uint32_t parent, const char* name, ak::uint32_t nameLength);
+        static ak::uint16_t find(ak::uint32_t parent, ak::uint32_t hash, const char* name, ak::uint32_t nameLength);
+        static void unlink(ak::uint16_t index);
+
+        static bool getSysInfoValue(const char* path, ak::uint64_t* value);
+    };
+}
@@ -0,0 +1,294 @@
+//
+//  filehandle.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 21/01/22.
+//
+
+#include "filehandle.h"
+#include "dentrycache.h"
+
+using namespace Kernel;
+using namespace pranaOS::ak;
+
+sharedInode fileHandleTable::sharedInodes[MAX_SHARED_INODES];
+spinLock fileHandleTable::sharedLock;
+
+fileHandleTable::fileHandleTable() {
+    for(int i = 0; i < MAX_OPEN_FILES; i++)
+        handles[i].used = false;
+}
+
+fileHandle* fileHandleTable::get(int handle) {
+    if(handle < 0 || handle >= MAX_OPEN_FILES || !handles[handle].used)
+        return 0;
+
+    return &handles[handle];
+}
+
+bool fileHandleTable::openInode(const char* path, int flags, vfsInode* result, sharedInode* key) {
+    vfsInode parent;
+    const char* name;
+    uint32_t nameLength;
+
+    // only the root has no last component, it never changes through a handle
+    bool hasParent = vfsManager::resolveParent(path, &parent, &name, &nameLength);
+    key->nameLength = 0;
+    if(hasParent && nameLength <= DENTRY_NAME_LENGTH) {
+        key->parent = parent.id;
+        key->nameLength = nameLength;
+        for(uint32_t i = 0; i < nameLength; i++)
+            key->name[i] = name[i];
+    }
+
+    if(vfsManager::resolve(path, result))
+        return true;
+
+    if(!hasParent || !(flags & VFS_OPEN_CREATE))
+        return false;
+
+    if(!vfsManager::getRoot()->create(&parent, name, nameLength, (flags & VFS_OPEN_DIRECTORY) != 0, result))
+        return false;
+
+    // replaces the negative entry resolve just left behind
+    dentryCache::insert(parent.id, name, nameLength, result);
+    return true;
+}
+
+static bool sameName(const sharedInode* a, const sharedInode* b) {
+    if(a->nameLength == 0 || a->nameLength != b->nameLength || a->parent != b->parent)
+        return false;
+
+    for(uint32_t i = 0; i < a->nameLength; i++)
+        if(a->name[i] != b->name[i])
+            return false;
+
+    return true;
+}
+
+sharedInode* fileHandleTable::acquireInode(virtualFileSystem* fs, const vfsInode* inode, const sharedInode* key) {
+    uint32_t lockFlags = sharedLock.lockIrqSave();
+
+    sharedInode* free = 0;
+    for(int i = 0; i < MAX_SHARED_INODES; i++) {
+        sharedInode* shared = &sharedInodes[i];
+        if(shared->references == 0) {
+            if(free == 0)
+                free = shared;
+            continue;
+        }
+
+        // id 0 means the file has no data yet (no first cluster for fat), such files are only told apart by name.
+        // An open file's inode is newer than whatever the dentry cache returned
+        if(shared->fs == fs && ((inode->id != 0 && shared->inode.id == inode->id) || sameName(shared, key))) {
+            shared->references++;
+            sharedLock.unlockIrqRestore(lockFlags);
+            return shared;
+        }
+    }
+
+    if(free != 0) {
+        free->fs = fs;
+        free->inode = *inode;
+        free->parent = key->parent;
+        free->nameLength = key->nameLength;
+        for(uint32_t i = 0; i < key->nameLength; i++)
+            free->name[i] = key->name[i];
+        free->references = 1;
+        free->generation = 0;
+    }
+
+    sharedLock.unlockIrqRestore(lockFlags);
+    return free;
+}
+
+void fileHandleTable::releaseInode(sharedInode* shared) {
+    uint32_t lockFlags = sharedLock.lockIrqSave();
+    shared->references--;
+    sharedLock.unlockIrqRestore(lockFlags);
+}
+
+int fileHandleTable::reserveHandle() {
+    uint32_t lockFlags = tableLock.lockIrqSave();
+
+    int handle = 0;
+    while(handle < MAX_OPEN_FILES && handles[handle].used)
+        handle++;
+
+    if(handle < MAX_OPEN_FILES)
+        handles[handle].used = true;
+
+    tableLock.unlockIrqRestore(lockFlags);
+    return handle < MAX_OPEN_FILES ? handle : -1;
+}
+
+void fileHandleTable::releaseHandle(int handle) {
+    uint32_t lockFlags = tableLock.lockIrqSave();
+    handles[handle].used = false;
+    tableLock.unlockIrqRestore(lockFlags);
+}
+
+void fileHandleTable::updateDentry(sharedInode* shared) {
+    if(shared->nameLength)
+        dentryCache::update(shared->parent, shared->name, shared->nameLength, &shared->inode);
+}
+
+void fileHandleTable::syncCursor(fileHandle* file) {
+    if(file->generation == file->shared->generation)
+        return;
+
+    file->cursor.block = 0;
+    file->cursor.blockStart = 0;
+    readAhead::reset(&file->cursor.readAhead);
+    file->generation = file->shared->generation;
+}
+
+int fileHandleTable::open(const char* path, int flags) {
+    vfsInode inode;
+    sharedInode key;
+    if(!openInode(path, flags, &inode, &key))
+        return -1;
+
+    if(inode.isDirectory != ((flags & VFS_OPEN_DIRECTORY) != 0))
+        return -1;
+
+    // take the slot first, a full table must not leave a truncated file behind
+    int handle = reserveHandle();
+    if(handle < 0)
+        return -1;
+
+    virtualFileSystem* fs = vfsManager::getRoot();
+    sharedInode* shared = acquireInode(fs, &inode, &key);
+    if(shared == 0) {
+        releaseHandle(handle);
+        return -1;
+    }
+
+    if((flags & VFS_OPEN_TRUNCATE) && (flags & VFS_OPEN_WRITE)) {
+        shared->lock.lock();
+        if(shared->inode.size > 0) {
+            if(!fs->truncate(&shared->inode, 0)) {
+                shared->lock.unlock();
+                releaseInode(shared);
+                releaseHandle(handle);
+                return -1;
+            }
+
+            shared->generation++;
+            updateDentry(shared);
+        }
+        shared->lock.unlock();
+    }
+
+    fileHandle* file = &handles[handle];
+    file->flags = flags;
+    file->shared = shared;
+    file->generation = shared->generation;
+    file->cursor.offset = 0;
+    file->cursor.block = 0;
+    file->cursor.blockStart = 0;
+    readAhead::reset(&file->cursor.readAhead);
+
+    return handle;
+}
+
+int fileHandleTable::read(int handle, uint8_t* buffer, uint32_t length) {
+    fileHandle* file = get(handle);
+    if(file == 0 || !(file->flags & VFS_OPEN_READ))
+        return -1;
+
+    sharedInode* shared = file->shared;
+    shared->lock.lock();
+    syncCursor(file);
+
+    int result = 0;
+    if(file->cursor.offset < shared->inode.size) {
+        if(length > shared->inode.size - file->cursor.offset)
+            length = shared->inode.size - file->cursor.offset;
+
+        result = shared->fs->read(&shared->inode, &file->cursor, buffer, length);
+    }
+
+    shared->lock.unlock();
+    return result;
+}
+
+int fileHandleTable::write(int handle, uint8_t* buffer, uint32_t length) {
+    fileHandle* file = get(handle);
+    if(file == 0 || !(file->flags & VFS_OPEN_WRITE))
+        return -1;
+
+    sharedInode* shared = file->shared;
+    shared->lock.lock();
+    syncCursor(file);
+
+    vfsInode old = shared->inode;
+    int result = shared->fs->write(&shared->inode, &file->cursor, buffer, length);
+
+    // the first write gives an empty file its id, later ones may only grow it
+    if(shared->inode.size != old.size || shared->inode.id != old.id)
+        updateDentry(shared);
+
+    shared->lock.unlock();
+    return result;
+}
+
+int fileHandleTable::seek(int handle, int32_t offset, vfsSeekOrigin origin) {
+    fileHandle* file = get(handle);
+    if(file == 0)
+        return -1;
+
+    sharedInode* shared = file->shared;
+    shared->lock.lock();
+    syncCursor(file);
+
+    int64_t position = offset;
+    if(origin == vfsSeekCurrent)
+        position += file->cursor.offset;
+    else if(origin == vfsSeekEnd)
+        position += shared->inode.size;
+
+    if(position < 0 || position > 0x7FFFFFFF) {
+        shared->lock.unlock();
+        return -1;
+    }
+
+    // the block hint only walks forward, going back means starting over at the first block
+    if((uint32_t)position < file->cursor.blockStart) {
+        file->cursor.block = 0;
+        file->cursor.blockStart = 0;
+    }
+
+    file->cursor.offset = position;
+    shared->lock.unlock();
+    return position;
+}
+
+int fileHandleTable::readDirectory(int handle, uint8_t* buffer, uint32_t size) {
+    fileHandle* file = get(handle);
+    if(file == 0 || !(file->flags & VFS_OPEN_READ) || !file->shared->inode.isDirectory)
+        return -1;
+
+    sharedInode* shared = file->shared;
+    shared->lock.lock();
+    int result = shared->fs->readDirectory(&shared->inode, &file->cursor, buffer, size);
+    shared->lock.unlock();
+
+    return result;
+}
+
+int fileHandleTable::close(int handle) {
+    fileHandle* file = get(handle);
+    if(file == 0)
+        return -1;
+
+    releaseInode(file->shared);
+    releaseHandle(handle);
+
+    return 0;
+}
+
+void fileHandleTable::closeAll() {
+    for(int i = 0; i < MAX_OPEN_FILES; i++)
+        close(i);
+}
@@ -0,0 +1,114 @@
+//
+//  filehandle.h
+//  pranaOS
+//
+//  Created by Krisna Pranav on 21/01/22.
+//
+
+#pragma once
+
+#include <ak/types.h>
+#include <tasking/lock.h>
+#include "vfs.h"
+#include "dentrycache.h"
+
+namespace Kernel {
+    #define MAX_OPEN_FILES 32
+    #define MAX_SHARED_INODES 64
+
+    // same values as the libc side in vfs.h
+    #define VFS_OPEN_READ (1 << 0)
+    #define VFS_OPEN_WRITE (1 << 1)
+    #define VFS_OPEN_CREATE (1 << 2)
+    #define VFS_OPEN_TRUNCATE (1 << 3)
+    #define VFS_OPEN_DIRECTORY (1 << 4)
+
+    enum vfsSeekOrigin {
+        vfsSeekSet,
+        vfsSeekCurrent,
+        vfsSeekEnd
+    };
+
+    /**
+     * @brief one per open file system wide, every handle on the file points here so a size
+     * change made through one handle is seen by all of them. generation moves on truncate
+     * so the other handles drop block hints into the freed chain.
+     * parent and name locate the file's dentry, nameLength is 0 when it has none in the cache.
+     */
+    struct sharedInode {
+        virtualFileSystem* fs;
+        vfsInode inode;
+        ak::uint32_t parent;
+        ak::uint8_t nameLength;
+        char name[DENTRY_NAME_LENGTH];
+        ak::uint32_t references;
+        ak::uint32_t generation;
+        mutexLock lock;
+    };
+
+    struct fileHandle {
+        bool used;
+        int flags;
+        sharedInode* shared;
+        ak::uint32_t generation;
+        vfsCursor cursor;
+    };
+
+    /**
+     * @brief per process table behind SYSCALL_OPEN .. SYSCALL_CLOSE.
+     * The path is resolved once at open, after that every call works on the inode and the
+     * handle's cursor, so a read continues from the cluster the previous one ended in.
+     */
+    class fileHandleTable {
+    public:
+        fileHandleTable();
+
+        int open(const char* path, int flags);
+        int read(int handle, ak::uint8_t* buffer, ak::uint32_t length);
+        int write(int handle, ak::uint8_t* buffer, ak::uint32_t length);
+        int seek(int handle, ak::int32_t offset, vfsSeekOrigin origin);
+        int close(int handle);
+
+        /**
+         * @brief kernel side of SYSCALL_GET_DIRENTS, handle must be opened with VFS_OPEN_DIRECTORY
+         */
+        int readDirectory(int handle, ak::uint8_t* buffer, ak::uint32_t size);
+
+        /**
+         * @brief open handle or 0, SYSCALL_MMAP takes the inode to map from here
+         */
+        fileHandle* get(int handle);
+
+        /**
+         * @brief called when the owning process exits
+         */
+        void closeAll();
+
+    private:
+        fileHandle handles[MAX_OPEN_FILES];
+        spinLock tableLock;
+
+        static sharedInode sharedInodes[MAX_SHARED_INODES];
+        static spinLock sharedLock;
+
+        /**
+         * @brief resolves or creates path, the dentry of the file goes to key (fs and inode unset)
+         */
+        bool openInode(const char* path, int flags, vfsInode* result, sharedInode* key);
+        int reserveHandle();
+        void releaseHandle(int handle);
+
+        static sharedInode* acquireInode(virtualFileSystem* fs, const vfsInode* inode, const sharedInode* key);
+        static void releaseInode(sharedInode* shared);
+
+        /**
+         * @brief called with shared->lock held before the cursor is used
+         */
+        static void syncCursor(fileHandle* file);
+
+        /**
+         * @brief pushes a changed inode to the file's dentry, called with shared->lock held
+         */
+        static void updateDentry(sharedInode* shared);
+    };
+}
@@ -0,0 +1,139 @@
+//
+//  vfs.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 21/01/22.
+//
+
+#include "vfs.h"
+#include "dentrycache.h"
+
+using namespace Kernel;
+using namespace pranaOS::ak;
+
+virtualFileSystem::virtualFileSystem() { }
+
+bool virtualFileSystem::getRoot(vfsInode* result) {
+    return false;
+}
+
+bool virtualFileSystem::lookup(vfsInode* directory, const char* name, uint32_t nameLength, vfsInode* result) {
+    return false;
+}
+
+bool virtualFileSystem::create(vfsInode* directory, const char* name, uint32_t nameLength, bool isDirectory, vfsInode* result) {
+    return false;
+}
+
+bool virtualFileSystem::truncate(vfsInode* file, uint32_t size) {
+    return false;
+}
+
+int virtualFileSystem::read(vfsInode* file, vfsCursor* cursor, uint8_t* buffer, uint32_t length) {
+    return -1;
+}
+
+int virtualFileSystem::write(vfsInode* file, vfsCursor* cursor, uint8_t* buffer, uint32_t length) {
+    return -1;
+}
+
+int virtualFileSystem::readDirectory(vfsInode* directory, vfsCursor* cursor, uint8_t* buffer, uint32_t size) {
+    return -1;
+}
+
+uint32_t virtualFileSystem::packDirent(uint8_t* buffer, uint32_t space, const vfsDirent* header, const char* name, uint32_t nameLength) {
+    if(nameLength > 255)
+        nameLength = 255;
+
+    uint32_t length = (sizeof(vfsDirent) + nameLength + 1 + 3) & ~3;
+    if(length > space)
+        return 0;
+
+    vfsDirent* entry = (vfsDirent*)buffer;
+    *entry = *header;
+    entry->recordLength = length;
+    entry->nameLength = nameLength;
+
+    for(uint32_t i = 0; i < nameLength; i++)
+        entry->name[i] = name[i];
+    for(uint32_t i = nameLength; i < length - sizeof(vfsDirent); i++)
+        entry->name[i] = '\0';
+
+    return length;
+}
+
+virtualFileSystem* vfsManager::rootFileSystem = 0;
+
+void vfsManager::mount(virtualFileSystem* fs) {
+    rootFileSystem = fs;
+    dentryCache::clear();
+}
+
+virtualFileSystem* vfsManager::getRoot() {
+    return rootFileSystem;
+}
+
+bool vfsManager::walk(const char* path, const char* end, vfsInode* result) {
+    if(rootFileSystem == 0 || !rootFileSystem->getRoot(result))
+        return false;
+
+    const char* p = path;
+    while(p < end) {
+        while(p < end && *p == VFS_PATH_SEPARATOR)
+            p++;
+        if(p == end)
+            break;
+
+        const char* name = p;
+        while(p < end && *p != VFS_PATH_SEPARATOR)
+            p++;
+        uint32_t length = p - name;
+
+        if(!result->isDirectory)
+            return false;
+
+        bool negative = false;
+        vfsInode child;
+        if(dentryCache::lookup(result->id, name, length, &child, &negative)) {
+            if(negative)
+                return false;
+        }
+        else if(rootFileSystem->lookup(result, name, length, &child))
+            dentryCache::insert(result->id, name, length, &child);
+        else {
+            dentryCache::insert(result->id, name, length, 0);
+            return false;
+        }
+
+        *result = child;
+    }
+
+    return true;
+}
+
+bool vfsManager::resolve(const char* path, vfsInode* result) {
+    const char* end = path;
+    while(*end)
+        end++;
+
+    return walk(path, end, result);
+}
+
+bool vfsManager::resolveParent(const char* path, vfsInode* parent, const char** name, uint32_t* nameLength) {
+    const char* end = path;
+    while(*end)
+        end++;
+    while(end > path && end[-1] == VFS_PATH_SEPARATOR)
+        end--;
+
+    const char* last = end;
+    while(last > path && last[-1] != VFS_PATH_SEPARATOR)
+        last--;
+
+    if(last == end)
+        return false;
+
+    *name = last;
+    *nameLength = end - last;
+    return walk(path, last, parent);
+}
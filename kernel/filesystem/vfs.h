@@ -0,0 +1,115 @@
+//
+//  vfs.h
+//  pranaOS
+//
+//  Created by Krisna Pranav on 21/01/22.
+//
+
+#pragma once
+
+#include <ak/types.h>
+#include <disks/readahead.h>
+
+namespace Kernel {
+    #define VFS_PATH_SEPARATOR '/'
+    #define VFS_DIRENT_DIRECTORY (1 << 0)
+
+    /**
+     * @brief what a filesystem needs to find a file again without a path walk,
+     * id is filesystem specific (the first cluster for fat)
+     */
+    struct vfsInode {
+        ak::uint32_t id;
+        ak::uint32_t parent;
+        ak::uint32_t size;
+        bool isDirectory;
+    };
+
+    /**
+     * @brief per handle file position. block and blockStart cache where the filesystem found
+     * offset last time (for fat the current cluster), so sequential reads never walk the chain
+     * from the start again. block is 0 until the filesystem fills it in.
+     */
+    struct vfsCursor {
+        ak::uint32_t offset;
+        ak::uint32_t block;
+        ak::uint32_t blockStart;
+        readAheadState readAhead;
+    };
+
+    /**
+     * @brief packed, variable length directory record filled in by getdents,
+     * same layout as vfsDirent in libc's shared.h. name is null terminated and
+     * recordLength is the distance to the next record, a multiple of 4.
+     */
+    struct vfsDirent {
+        ak::uint16_t recordLength;
+        ak::uint8_t nameLength;
+        ak::uint8_t flags;
+        ak::uint32_t size;
+
+        ak::uint8_t sec;
+        ak::uint8_t min;
+        ak::uint8_t hour;
+        ak::uint8_t day;
+        ak::uint8_t month;
+        ak::uint16_t year;
+
+        char name[];
+    } __attribute__((packed));
+
+    /**
+     * @brief interface a filesystem driver implements, paths never reach it,
+     * the vfs walks them one component at a time through lookup
+     */
+    class virtualFileSystem {
+    public:
+        virtualFileSystem();
+
+        virtual bool getRoot(vfsInode* result);
+        virtual bool lookup(vfsInode* directory, const char* name, ak::uint32_t nameLength, vfsInode* result);
+        virtual bool create(vfsInode* directory, const char* name, ak::uint32_t nameLength, bool isDirectory, vfsInode* result);
+        virtual bool truncate(vfsInode* file, ak::uint32_t size);
+
+        /**
+         * @brief transfer at cursor->offset, advance the cursor and keep its block hint current,
+         * return the number of bytes moved or -1
+         */
+        virtual int read(vfsInode* file, vfsCursor* cursor, ak::uint8_t* buffer, ak::uint32_t length);
+        virtual int write(vfsInode* file, vfsCursor* cursor, ak::uint8_t* buffer, ak::uint32_t length);
+
+        /**
+         * @brief packs as many entries as fit into buffer starting at cursor->offset (an entry
+         * index), advances the cursor past them and returns the bytes used, 0 at the end
+         */
+        virtual int readDirectory(vfsInode* directory, vfsCursor* cursor, ak::uint8_t* buffer, ak::uint32_t size);
+
+    protected:
+        /**
+         * @brief appends one record, returns its length or 0 when it does not fit in space
+         */
+        static ak::uint32_t packDirent(ak::uint8_t* buffer, ak::uint32_t space, const vfsDirent* header, const char* name, ak::uint32_t nameLength);
+    };
+
+    class vfsManager {
+    public:
+        static void mount(virtualFileSystem* fs);
+        static virtualFileSystem* getRoot();
+
+        /**
+         * @brief path to inode through the dentry cache, the filesystem is only asked for
+         * components the cache does not know yet
+         */
+        static bool resolve(const char* path, vfsInode* result);
+
+        /**
+         * @brief resolves everything but the last component, name points into path
+         */
+        static bool resolveParent(const char* path, vfsInode* parent, const char** name, ak::uint32_t* nameLength);
+
+    private:
+        static virtualFileSystem* rootFileSystem;
+
+        static bool walk(const char* path, const char* end, vfsInode* result);
+    };
+}
@@ -5,7 +5,7 @@
 #include <memory/fifostream.h>
 
 namespace Kernel {
-    class keyboardManager : public FIFOStream {
+    class keyboardManager : public system::FIFOStream {
     public:
         List<Keyboard*> keyboards;
         keyboardStatus sharedStatus;
@@ -0,0 +1,36 @@
+#include "fifostream.h"
+
+using namespace Kernel;
+using namespace Kernel::system;
+using namespace pranaOS::ak;
+
+FIFOStream::FIFOStream(int capacity)
+: Stream(), ring(capacity) {
+
+}
+
+FIFOStream::~FIFOStream() {
+
+}
+
+char FIFOStream::read() {
+    char byte = 0;
+    ring.read(&byte);
+    return byte;
+}
+
+void FIFOStream::write(char byte) {
+    ring.write(byte);
+}
+
+int FIFOStream::available() {
+    return ring.available();
+}
+
+uint32_t FIFOStream::readBatch(char* buffer, uint32_t count) {
+    return ring.readBatch(buffer, count);
+}
+
+uint32_t FIFOStream::writeBatch(const char* buffer, uint32_t count) {
+    return ring.writeBatch(buffer, count);
+}
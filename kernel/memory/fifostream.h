@@ -3,26 +3,29 @@
 #include <ak/types.h>
 #include <ak/memoperator.h>
 #include "stream.h"
+#include "ringbuffer.h"
 
 namespace Kernel {
     namespace system {
 
+        /**
+         * @brief byte stream on top of a lock free ring, the irq side writes and the reader side reads,
+         * readBatch/writeBatch move many bytes without a virtual call per byte
+         */
         class FIFOStream : public Stream {
         public:
-            FIFOStream(int capacity = 100);
+            FIFOStream(int capacity = 128);
             ~FIFOStream();
 
             char read();
             void write(char byte);
             int available();
 
+            ak::uint32_t readBatch(char* buffer, ak::uint32_t count);
+            ak::uint32_t writeBatch(const char* buffer, ak::uint32_t count);
+
         private:
-            char* buffer;
-            char* buffer_end;
-            int count;
-            int capacity;
-            char* head;
-            char* tail;
+            ringBuffer<char> ring;
         };
     }
-}
\ No newline at end of file
+}
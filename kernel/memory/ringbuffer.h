@@ -0,0 +1,131 @@
+#pragma once
+
+#include <ak/types.h>
+#include <ak/memoperator.h>
+
+namespace Kernel {
+    namespace system {
+
+        /**
+         * @brief lock free single producer / single consumer ring.
+         * One side (for example an irq handler) only calls write*, the other side only calls read*.
+         * Capacity is rounded up to a power of two and elements are copied with memcpy, so T must be plain data.
+         */
+        template<typename T>
+        class ringBuffer {
+        public:
+            ringBuffer(ak::uint32_t capacity = 128)
+            {
+                ak::uint32_t size = 1;
+                while (size < capacity)
+                    size <<= 1;
+
+                this->buffer = new T[size];
+                this->mask = size - 1;
+                this->head = 0;
+                this->tail = 0;
+            }
+
+            ~ringBuffer()
+            {
+                delete[] this->buffer;
+            }
+
+            bool write(const T& item)
+            {
+                ak::uint32_t h = this->head;
+                if (h - this->tail > this->mask)
+                    return false;
+
+                this->buffer[h & this->mask] = item;
+                asm volatile ("" ::: "memory");
+                this->head = h + 1;
+                return true;
+            }
+
+            bool read(T* item)
+            {
+                ak::uint32_t t = this->tail;
+                if (t == this->head)
+                    return false;
+
+                asm volatile ("" ::: "memory");
+                *item = this->buffer[t & this->mask];
+                asm volatile ("" ::: "memory");
+                this->tail = t + 1;
+                return true;
+            }
+
+            ak::uint32_t writeBatch(const T* items, ak::uint32_t count)
+            {
+                ak::uint32_t h = this->head;
+                ak::uint32_t space = this->capacity() - (h - this->tail);
+                if (count > space)
+                    count = space;
+
+                copyIn(h, items, count);
+                asm volatile ("" ::: "memory");
+                this->head = h + count;
+                return count;
+            }
+
+            ak::uint32_t readBatch(T* items, ak::uint32_t count)
+            {
+                ak::uint32_t t = this->tail;
+                ak::uint32_t used = this->head - t;
+                if (count > used)
+                    count = used;
+
+                asm volatile ("" ::: "memory");
+                copyOut(t, items, count);
+                asm volatile ("" ::: "memory");
+                this->tail = t + count;
+                return count;
+            }
+
+            ak::uint32_t available()
+            {
+                return this->head - this->tail;
+            }
+
+            ak::uint32_t space()
+            {
+                return this->capacity() - this->available();
+            }
+
+            ak::uint32_t capacity()
+            {
+                return this->mask + 1;
+            }
+
+        private:
+            T* buffer;
+            ak::uint32_t mask;
+
+            volatile ak::uint32_t head __attribute__((aligned(64)));
+            volatile ak::uint32_t tail __attribute__((aligned(64)));
+
+            void copyIn(ak::uint32_t position, const T* items, ak::uint32_t count)
+            {
+                ak::uint32_t index = position & this->mask;
+                ak::uint32_t first = this->capacity() - index;
+                if (first > count)
+                    first = count;
+
+                ak::memOperator::memcpy(this->buffer + index, items, first * sizeof(T));
+                ak::memOperator::memcpy(this->buffer, items + first, (count - first) * sizeof(T));
+            }
+
+            void copyOut(ak::uint32_t position, T* items, ak::uint32_t count)
+            {
+                ak::uint32_t index = position & this->mask;
+                ak::uint32_t first = this->capacity() - index;
+                if (first > count)
+                    first = count;
+
+                ak::memOperator::memcpy(items, this->buffer + index, first * sizeof(T));
+                ak::memOperator::memcpy(items + first, this->buffer, (count - first) * sizeof(T));
+            }
+        };
+    }
+}
@@ -1,4 +1,5 @@
 #include "console.h"
+#include <ak/memoperator.h>
 
 using namespace Kernel;
 using namespace Kernel::ak;
@@ -8,27 +9,75 @@ int bootConsole::yoffset = 0;
 uint8_t bootConsole::backgroundcolor = VGA_COLOR_BLACK; 
 uint8_t bootConsole::foregroundcolor = VGA_COLOR_WHITE; 
 bool bootConsole::writeToSerial = false;
+bool bootConsole::autoFlush = true;
+
+uint16_t bootConsole::shadowBuffer[VGA_WIDTH * VGA_HEIGHT];
+int bootConsole::topLine = 0;
+uint32_t bootConsole::dirtyLines = 0;
+
+#define ALL_LINES_DIRTY ((1 << VGA_HEIGHT) - 1)
 
 static uint16_t* videoMemory = (uint16_t*)0xC00B8000;
 
+uint16_t* bootConsole::shadowLine(int row) {
+    return shadowBuffer + ((topLine + row) % VGA_HEIGHT) * VGA_WIDTH;
+}
+
+void bootConsole::clearLine(int row) {
+    uint16_t attrib = (backgroundcolor << 4) | (foregroundcolor & 0x0F);
+    uint16_t* line = shadowLine(row);
+
+    for(int x = 0; x < VGA_WIDTH; x++)
+        line[x] = ' ' | (attrib << 8);
+
+    dirtyLines |= 1 << row;
+}
+
 void bootConsole::scroll() {
-    for(int i = 0; i < 24; i++){
-        for (int m = 0; m < 80; m++){
-            videoMemory[i * 80 + m] = videoMemory[(i + 1) * 80 + m];
-        }
-    }
+    topLine = (topLine + 1) % VGA_HEIGHT;
+    clearLine(VGA_HEIGHT - 1);
+
+    dirtyLines = ALL_LINES_DIRTY;
+}
 
-    for(int x = 0; x < 80; x++)
+void bootConsole::flush() {
+    int row = 0;
+    while(row < VGA_HEIGHT)
     {
-        uint16_t attrib = (backgroundcolor << 4) | (foregroundcolor & 0x0F);
-        volatile uint16_t * where;
-        where = (volatile uint16_t *)videoMemory + (24 * VGA_WIDTH + x) ;
-        *where = ' ' | (attrib << 8);
+        if(!(dirtyLines & (1 << row))) {
+            row++;
+            continue;
+        }
+
+        int first = row;
+        int shadowRow = (topLine + row) % VGA_HEIGHT;
+        do {
+            row++;
+        } while(row < VGA_HEIGHT && (dirtyLines & (1 << row)) && (topLine + row) % VGA_HEIGHT != 0);
+
+        ::ak::memOperator::memcpy(videoMemory + first * VGA_WIDTH, shadowBuffer + shadowRow * VGA_WIDTH, (row - first) * VGA_WIDTH * sizeof(uint16_t));
     }
+
+    dirtyLines = 0;
+}
+
+void bootConsole::setAutoFlush(bool enabled) {
+    autoFlush = enabled;
+    if(enabled)
+        flush();
+}
+
+void bootConsole::flushPending() {
+    if(autoFlush && dirtyLines)
+        flush();
 }
 
 void bootConsole::init(bool enableSerial) {
     bootConsole::writeToSerial = enableSerial;
+    ::ak::memOperator::memcpy(shadowBuffer, videoMemory, sizeof(shadowBuffer));
+    topLine = 0;
+    dirtyLines = 0;
+
     if(enableSerial)
     {
         serialPort::init(COMPort::COM1);
@@ -36,47 +85,62 @@ void bootConsole::init(bool enableSerial) {
     }
 }
 
+void bootConsole::putChar(char c, uint16_t attrib) {
+    switch(c)
+    {
+        case '\n':
+            xoffset = 0;
+            yoffset++;
+            break;
+        case '\t':
+            for(int t = 0; t < 4; t++) {
+                if(xoffset >= VGA_WIDTH)
+                    break;
+                shadowLine(yoffset)[xoffset++] = ' ' | (attrib << 8);
+            }
+            dirtyLines |= 1 << yoffset;
+            break;
+        default:
+            shadowLine(yoffset)[xoffset] = c | (attrib << 8);
+            dirtyLines |= 1 << yoffset;
+            xoffset++;
+            break;
+    }
+
+    if(xoffset >= VGA_WIDTH) {
+        xoffset = 0;
+        yoffset++;
+    }
+
+    if(yoffset >= VGA_HEIGHT) {
+        scroll();
+        xoffset = 0;
+        yoffset = VGA_HEIGHT - 1;
+    }
+}
+
 void bootConsole::write(char c) {
-    static char* str = " ";
-    str[0] = c;
-    write(str);
+    if (writeToSerial)
+        serialPort::write(c);
+
+    putChar(c, (backgroundcolor << 4) | (foregroundcolor & 0x0F));
+
+    // single characters usually come in bursts, only push whole lines to the screen
+    if(autoFlush && c == '\n')
+        flush();
 }
 
 void bootConsole::write(char* str) {
     if (writeToSerial)
         serialPort::writeStr(str);
 
-    for(int i = 0; str[i] != '\0'; ++i)
-    {
-        switch(str[i])
-        {
-            case '\n':
-                xoffset = 0;
-                yoffset++;
-                break;
-            case '\t':
-                write("    "); 
-                break;
-            default:
-                uint16_t attrib = (backgroundcolor << 4) | (foregroundcolor & 0x0F);
-                volatile uint16_t * where;
-                where = (volatile uint16_t *)videoMemory + (yoffset * 80 + xoffset) ;
-                *where = str[i] | (attrib << 8);
-                xoffset++;
-                break;
-        }
+    uint16_t attrib = (backgroundcolor << 4) | (foregroundcolor & 0x0F);
 
-        if(xoffset >= 80) {
-            xoffset = 0;
-            yoffset++;
-        }
+    for(int i = 0; str[i] != '\0'; ++i)
+        putChar(str[i], attrib);
 
-        if(yoffset >= 25) {
-            scroll();
-            xoffset = 0;
-            yoffset = 24;
-        }
-    }
+    if(autoFlush)
+        flush();
 }
 
 void bootConsole::writeLine(char* str) {
@@ -90,18 +154,16 @@ void bootConsole::writeLine() {
 
 void bootConsole::clear() {
     for(int y = 0; y < VGA_HEIGHT; y++)
-        for(int x = 0; x < VGA_WIDTH; x++) {
-                uint16_t attrib = (backgroundcolor << 4) | (foregroundcolor & 0x0F);
-                volatile uint16_t * where;
-                where = (volatile uint16_t *)videoMemory + (y * VGA_WIDTH + x) ;
-                *where = ' ' | (attrib << 8);
-        }
+        clearLine(y);
 
     xoffset = 0;
     yoffset = 0;
+
+    flush();
 }
 
 uint16_t* bootConsole::getBuffer() {
+    flush();
     return videoMemory;
 }
 
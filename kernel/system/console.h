@@ -44,13 +44,39 @@ namespace Kernel {
         static void setx(int x);
         static void sety(int y);
 
+        /**
+         * @brief copies the dirty lines of the shadow buffer to vga memory,
+         * done automatically after every string and every newline written
+         * through write(char) unless auto flush is disabled
+         */
+        static void flush();
+        static void setAutoFlush(bool enabled);
+
+        /**
+         * @brief pushes out a line write(char) left unfinished, such as a prompt,
+         * run by deferredWork whenever a cpu goes idle
+         */
+        static void flushPending();
+
         static ak::uint16_t* getBuffer();
         
     private:
         static int xoffset;
         static int yoffset;
         static bool writeToSerial;
+        static bool autoFlush;
+
+        /**
+         * @brief screen content lives in a shadow ring of lines, topLine is the
+         * shadow line shown on the first screen row so scrolling is an index change
+         */
+        static ak::uint16_t shadowBuffer[VGA_WIDTH * VGA_HEIGHT];
+        static int topLine;
+        static ak::uint32_t dirtyLines;
 
+        static ak::uint16_t* shadowLine(int row);
+        static void putChar(char c, ak::uint16_t attrib);
+        static void clearLine(int row);
         static void scroll();
     };
 }
\ No newline at end of file
@@ -0,0 +1,27 @@
+//
+//  deferred.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 17/01/22.
+//
+
+#include "deferred.h"
+#include <system/trace.h>
+#include <system/console.h>
+
+using namespace Kernel;
+using namespace Kernel::system;
+using namespace pranaOS::ak;
+
+volatile uint32_t deferredWork::running = 0;
+
+void deferredWork::run() {
+    if(__sync_lock_test_and_set(&running, 1))
+        return;
+
+    // small batches keep the wait that called us responsive, the next idle round continues
+    traceManager::drain(DEFERRED_TRACE_BATCH);
+    bootConsole::flushPending();
+
+    __sync_lock_release(&running);
+}
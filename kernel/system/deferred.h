@@ -0,0 +1,31 @@
+//
+//  deferred.h
+//  pranaOS
+//
+//  Created by Krisna Pranav on 17/01/22.
+//
+
+#pragma once
+
+#include <ak/types.h>
+
+namespace Kernel {
+    namespace system {
+        #define DEFERRED_TRACE_BATCH 32
+
+        /**
+         * @brief low priority work that must not run inline with its producer. Runs whenever a cpu
+         * has nothing else to do: before a waitQueue halts and from the scheduler's idle loop
+         */
+        class deferredWork {
+        public:
+            /**
+             * @brief one bounded round of every job, returns at once when another caller is inside
+             */
+            static void run();
+
+        private:
+            static volatile ak::uint32_t running;
+        };
+    }
+}
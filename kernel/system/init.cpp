@@ -0,0 +1,203 @@
+//
+//  init.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 22/01/22.
+//
+
+#include "init.h"
+#include <cpu/memory.h>
+#include <cpu/paging.h>
+#include <system/log.h>
+
+using namespace Kernel;
+using namespace Kernel::core;
+using namespace Kernel::system;
+using namespace pranaOS;
+using namespace pranaOS::ak;
+
+uint32_t Intial::archiveStart = 0;
+uint32_t Intial::archiveEnd = 0;
+uint32_t Intial::moduleStart = 0;
+uint32_t Intial::moduleEnd = 0;
+initIndexEntry Intial::index[INIT_INDEX_SIZE];
+bool Intial::indexComplete = true;
+
+uint32_t Intial::hashPath(const char* path) {
+    // fnv-1a
+    uint32_t hash = 2166136261u;
+    while(*path) {
+        hash ^= (uint8_t)*path++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+void Intial::initialize(multiboot_info_t* mbi) {
+    if(mbi->mods_count == 0) {
+        log(Warning, "no init archive loaded");
+        return;
+    }
+
+    // the module can sit anywhere in physical memory, the first window mappings need no new page table
+    multiboot_module_t* module = (multiboot_module_t*)virtualMemoryManager::mapPhysical(mbi->mods_addr, sizeof(multiboot_module_t), 0);
+    if(module == 0) {
+        log(Error, "init archive could not be mapped");
+        return;
+    }
+
+    moduleStart = module->mod_start;
+    moduleEnd = module->mod_end;
+
+    // the archive stays in place for the lifetime of the kernel, files are handed out by pointer.
+    // Reserve it before mapping, a page table for the mapping must not land inside it
+    physicalMemoryManager::setRegionUsed(moduleStart, moduleEnd - moduleStart);
+
+    archiveStart = virtualMemoryManager::mapPhysical(moduleStart, moduleEnd - moduleStart, 0);
+    if(archiveStart == 0) {
+        log(Error, "init archive could not be mapped");
+        return;
+    }
+    archiveEnd = archiveStart + (moduleEnd - moduleStart);
+
+    ::ak::memOperator::memset(index, 0, sizeof(index));
+
+    uint32_t count = 0;
+    uint32_t position = archiveStart;
+    while(position + sizeof(init) <= archiveEnd) {
+        init* header = (init*)position;
+        if(header->path[0] == '\0' || header->size > archiveEnd - position - sizeof(init))
+            break;
+
+        position += sizeof(init) + header->size;
+
+        if(count == INIT_INDEX_LIMIT) {
+            indexComplete = false;
+            continue;
+        }
+
+        uint32_t hash = hashPath(header->path);
+        uint32_t slot = hash % INIT_INDEX_SIZE;
+        while(index[slot].header != 0)
+            slot = (slot + 1) % INIT_INDEX_SIZE;
+
+        index[slot].hash = hash;
+        index[slot].header = header;
+        count++;
+    }
+
+    if(!indexComplete)
+        log(Warning, "init archive has more than %d files, the rest is found by scanning", INIT_INDEX_LIMIT);
+}
+
+init* Intial::find(const char* path) {
+    uint32_t hash = hashPath(path);
+    uint32_t slot = hash % INIT_INDEX_SIZE;
+
+    while(index[slot].header != 0) {
+        if(index[slot].hash == hash && String::strcmp(index[slot].header->path, path))
+            return index[slot].header;
+        slot = (slot + 1) % INIT_INDEX_SIZE;
+    }
+
+    if(indexComplete)
+        return 0;
+
+    uint32_t position = archiveStart;
+    while(position + sizeof(init) <= archiveEnd) {
+        init* header = (init*)position;
+        if(header->path[0] == '\0' || header->size > archiveEnd - position - sizeof(init))
+            break;
+
+        if(String::strcmp(header->path, path))
+            return header;
+
+        position += sizeof(init) + header->size;
+    }
+
+    return 0;
+}
+
+void* Intial::readFile(const char* path, uint32_t* fileSizeReturn) {
+    init* header = find(path);
+    if(header == 0)
+        return 0;
+
+    if(fileSizeReturn)
+        *fileSizeReturn = header->size;
+
+    return (void*)(header + 1);
+}
+
+uint32_t Intial::getPhysicalAddress(const char* path, uint32_t* fileSizeReturn) {
+    void* data = readFile(path, fileSizeReturn);
+    if(data == 0)
+        return 0;
+
+    return moduleStart + ((uint32_t)data - archiveStart);
+}
+
+/**
+ * @brief gives the module page at page a private copy holding only the bytes of the file
+ * [physical, physical + size), the rest of the page is zeroed
+ */
+bool Intial::mapEdgePage(uint32_t virtualPage, uint32_t page, uint32_t physical, uint32_t size) {
+    uint32_t frame = (uint32_t)physicalMemoryManager::allocateBlock();
+    if(frame == 0)
+        return false;
+
+    // kernel only until the copy is complete
+    if(!virtualMemoryManager::mapPage(virtualPage, frame, PAGE_WRITABLE)) {
+        physicalMemoryManager::freeBlock((void*)frame);
+        return false;
+    }
+
+    uint32_t start = physical > page ? physical : page;
+    uint32_t end = physical + size < page + PAGE_SIZE ? physical + size : page + PAGE_SIZE;
+
+    ::ak::memOperator::memset((void*)virtualPage, 0, PAGE_SIZE);
+    ::ak::memOperator::memcpy((void*)(virtualPage + (start - page)), (void*)(archiveStart + (start - moduleStart)), end - start);
+
+    virtualMemoryManager::mapPage(virtualPage, frame, PAGE_USER);
+    return true;
+}
+
+uint32_t Intial::mapFile(const char* path, uint32_t virtualBase, uint32_t* fileSizeReturn) {
+    uint32_t size = 0;
+    uint32_t physical = getPhysicalAddress(path, &size);
+    if(physical == 0 || (virtualBase & (PAGE_SIZE - 1)))
+        return 0;
+
+    uint32_t first = pageRoundDown(physical);
+    uint32_t last = pageRoundUp(physical + size);
+
+    for(uint32_t page = first; page < last; page += PAGE_SIZE) {
+        bool partial = page < physical || page + PAGE_SIZE > physical + size;
+        bool mapped = partial ? mapEdgePage(virtualBase + (page - first), page, physical, size)
+                              : virtualMemoryManager::mapPage(virtualBase + (page - first), page, PAGE_USER);
+
+        if(!mapped) {
+            if(page > first)
+                unmapFile(virtualBase, page - first);
+            return 0;
+        }
+    }
+
+    if(fileSizeReturn)
+        *fileSizeReturn = size;
+
+    return virtualBase + (physical - first);
+}
+
+void Intial::unmapFile(uint32_t address, uint32_t size) {
+    uint32_t end = pageRoundUp(address + size);
+
+    for(uint32_t page = pageRoundDown(address); page < end; page += PAGE_SIZE) {
+        uint32_t frame = virtualMemoryManager::unmapPage(page);
+
+        // edge pages are copies, the module itself is never freed
+        if(frame && (frame < moduleStart || frame >= moduleEnd))
+            physicalMemoryManager::freeBlock((void*)frame);
+    }
+}
@@ -6,15 +6,55 @@
 #include <system/console.h>
 
 namespace Kernel {
+    #define INIT_INDEX_SIZE 256
+    #define INIT_INDEX_LIMIT (INIT_INDEX_SIZE * 3 / 4)
+
     struct init {
         char name[30];
         char path[100];
         ak::uint32_t size;
     } __attribute__((packed));
 
+    /**
+     * @brief open addressing slot, header 0 marks an empty slot
+     */
+    struct initIndexEntry {
+        ak::uint32_t hash;
+        init* header;
+    };
+
     class Intial {
     public:
         static void initialize(multiboot_info_t* mbi);
         static void* readFile(const char* path, ak::uint32_t* fileSizeReturn = 0);
+
+        /**
+         * @brief physical address of the file data inside the boot module, 0 when not found
+         */
+        static ak::uint32_t getPhysicalAddress(const char* path, ak::uint32_t* fileSizeReturn = 0);
+
+        /**
+         * @brief maps a file read only at virtualBase (page aligned) of the active address space,
+         * returns the address of the first byte, 0 on failure. Whole pages of the module are
+         * shared, the partial first and last page are copies so the neighbouring records stay hidden.
+         */
+        static ak::uint32_t mapFile(const char* path, ak::uint32_t virtualBase, ak::uint32_t* fileSizeReturn = 0);
+
+        /**
+         * @brief undoes mapFile, address and size as returned by it
+         */
+        static void unmapFile(ak::uint32_t address, ak::uint32_t size);
+
+    private:
+        static ak::uint32_t archiveStart;
+        static ak::uint32_t archiveEnd;
+        static ak::uint32_t moduleStart;
+        static ak::uint32_t moduleEnd;
+        static initIndexEntry index[INIT_INDEX_SIZE];
+        static bool indexComplete;
+
+        static ak::uint32_t hashPath(const char* path);
+        static init* find(const char* path);
+        static bool mapEdgePage(ak::uint32_t virtualPage, ak::uint32_t page, ak::uint32_t physical, ak::uint32_t size);
     };
-}
\ No newline at end of file
+}
@@ -6,55 +6,165 @@
 //
 
 #include "interrupthandler.h"
+#include <ak/memoperator.h>
+#include <cpu/cpu.h>
+#include <system/log.h>
+#include <system/sysinfo.h>
 
-using namespace pranaOS;
+using namespace Kernel;
+using namespace Kernel::system;
 using namespace pranaOS::ak;
-using namespace pranaOS::system;
 
 
 interruptHandler::interruptHandler(ak::uint8_t interruptNumber) {
-    interruptManager::addHandler(this, interruptNumber);
+    if(!interruptManager::addHandler(this, interruptNumber))
+        log(Error, "interrupt %d already has %d handlers, handler not installed", interruptNumber, MAX_SHARED_HANDLERS);
 }
 
 uint32_t interruptHandler::handleInterrupt(uint32_t esp) {
     return esp;
 }
 
-List<interruptHandler*>* interruptManager::interruptCallbacks[256];
+interruptVector interruptManager::vectors[256][2];
+volatile uint8_t interruptManager::activeSlot[256];
+spinLock interruptManager::updateLock;
+interruptStatistics interruptManager::statistics[256];
+
 void interruptManager::initialize() {
     for(int i = 0; i < 256; i++)
     {
-        interruptCallbacks[i] = 0;
+        vectors[i][0].count = 0;
+        vectors[i][1].count = 0;
+        vectors[i][0].readers = 0;
+        vectors[i][1].readers = 0;
+        activeSlot[i] = 0;
     }
+
+    resetStatistics();
+    systemInfoManager::registerProvider("interrupts", interruptManager::getSysInfoValue);
 }
 
 uint32_t interruptManager::handleInterrupt(uint8_t num, uint32_t esp) {
-    if(interruptCallbacks[num] == 0)
-        return esp;
-    
-    if(interruptCallbacks[num]->size() == 0)
-        return esp;
-    
-    for(int i = 0; i < interruptCallbacks[num]->size(); i++)
-    {
-        interruptHandler* handler = interruptCallbacks[num]->GetAt(i);
-        esp = handler->handleInterrupt(esp);
+    uint64_t start = Cpu::readTimestamp();
+
+    // register as a reader first and only then confirm the slot is still active,
+    // an updater flipping in between sees the count and waits for us to back out
+    interruptVector* vector;
+    while(true) {
+        uint8_t slot = activeSlot[num];
+        vector = &vectors[num][slot];
+        __sync_fetch_and_add(&vector->readers, 1);
+
+        if(activeSlot[num] == slot)
+            break;
+
+        __sync_fetch_and_sub(&vector->readers, 1);
     }
 
+    uint32_t count = vector->count;
+    for(uint32_t i = 0; i < count; i++)
+        esp = vector->handlers[i]->handleInterrupt(esp);
+
+    __sync_fetch_and_sub(&vector->readers, 1);
+
+    uint64_t cycles = Cpu::readTimestamp() - start;
+    interruptStatistics* stats = &statistics[num];
+    stats->count++;
+    stats->totalCycles += cycles;
+    if(cycles > stats->maxCycles)
+        stats->maxCycles = cycles;
+
     return esp;
 }
 
-void interruptManager::addHandler(interruptHandler* handler, uint8_t interrupt) {
-    if(interruptCallbacks[interrupt] == 0)
-        interruptCallbacks[interrupt] = new List<interruptHandler*>();
+bool interruptManager::addHandler(interruptHandler* handler, uint8_t interrupt) {
+    uint32_t flags = updateLock.lockIrqSave();
+
+    uint8_t slot = activeSlot[interrupt];
+    interruptVector* current = &vectors[interrupt][slot];
+    interruptVector* next = &vectors[interrupt][slot ^ 1];
+
+    if(current->count >= MAX_SHARED_HANDLERS) {
+        updateLock.unlockIrqRestore(flags);
+        return false;
+    }
+
+    waitForReaders(next);
+
+    for(uint32_t i = 0; i < current->count; i++)
+        next->handlers[i] = current->handlers[i];
     
-    interruptCallbacks[interrupt]->push_back(handler);
+    next->handlers[current->count] = handler;
+    next->count = current->count + 1;
+
+    asm volatile("" ::: "memory");
+    activeSlot[interrupt] = slot ^ 1;
+
+    updateLock.unlockIrqRestore(flags);
+    return true;
 }
 
 void interruptManager::removeHandler(interruptHandler* handler, uint8_t interrupt) {
-    interruptCallbacks[interrupt]->Remove(handler);
-    if(interruptCallbacks[interrupt]->size() == 0) {
-        delete interruptCallbacks[interrupt];
-        interruptCallbacks[interrupt] = 0;
+    uint32_t flags = updateLock.lockIrqSave();
+
+    uint8_t slot = activeSlot[interrupt];
+    interruptVector* current = &vectors[interrupt][slot];
+    interruptVector* next = &vectors[interrupt][slot ^ 1];
+
+    waitForReaders(next);
+
+    uint32_t count = 0;
+    for(uint32_t i = 0; i < current->count; i++)
+        if(current->handlers[i] != handler)
+            next->handlers[count++] = current->handlers[i];
+    
+    next->count = count;
+
+    asm volatile("" ::: "memory");
+    activeSlot[interrupt] = slot ^ 1;
+
+    // dispatches that started before the flip may still be calling the removed handler
+    waitForReaders(current);
+
+    updateLock.unlockIrqRestore(flags);
+}
+
+void interruptManager::waitForReaders(interruptVector* vector) {
+    __sync_synchronize();
+
+    while(vector->readers != 0)
+        asm volatile("pause" ::: "memory");
+}
+
+interruptStatistics interruptManager::getStatistics(uint8_t interrupt) {
+    return statistics[interrupt];
+}
+
+void interruptManager::resetStatistics() {
+    ak::memOperator::memset(statistics, 0, sizeof(statistics));
+}
+
+/**
+ * @brief "interrupts.vectors", "interrupts.<n>.count", "interrupts.<n>.cycles" and "interrupts.<n>.maxcycles"
+ */
+bool interruptManager::getSysInfoValue(const char* path, uint64_t* value) {
+    if(systemInfoManager::isKey(path, "vectors")) {
+        *value = 256;
+        return true;
     }
+
+    uint32_t vector = 0;
+    if(!systemInfoManager::readIndex(&path, &vector) || vector > 255)
+        return false;
+
+    if(systemInfoManager::isKey(path, "count"))
+        *value = statistics[vector].count;
+    else if(systemInfoManager::isKey(path, "cycles"))
+        *value = statistics[vector].totalCycles;
+    else if(systemInfoManager::isKey(path, "maxcycles"))
+        *value = statistics[vector].maxCycles;
+    else
+        return false;
+
+    return true;
 }
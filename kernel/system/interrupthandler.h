@@ -7,28 +7,63 @@
 
 #pragma once
 
-#include <ak/list.h>
 #include <ak/types.h>
+#include <tasking/lock.h>
 
 namespace Kernel {
     namespace system {
+        #define MAX_SHARED_HANDLERS 14
+
         class interruptHandler {
         public:
             interruptHandler(ak::uint8_t intNumber);
             virtual ak::uint32_t handleInterrupt(ak::uint32_t esp);
         };
 
+        /**
+         * @brief handlers of one vector, exactly one cache line,
+         * readers counts the dispatches currently walking this copy
+         */
+        struct interruptVector {
+            interruptHandler* handlers[MAX_SHARED_HANDLERS];
+            ak::uint32_t count;
+            volatile ak::uint32_t readers;
+        } __attribute__((aligned(64)));
+
+        struct interruptStatistics {
+            ak::uint64_t count;
+            ak::uint64_t totalCycles;
+            ak::uint64_t maxCycles;
+        };
 
         class interruptManager {
         public:
             static void initialize();
             static ak::uint32_t handleInterrupt(ak::uint8_t interrupt, ak::uint32_t esp);
 
-            static void addHandler(interruptHandler* handler, ak::uint8_t interrupt);
+            static bool addHandler(interruptHandler* handler, ak::uint8_t interrupt);
+
+            /**
+             * @brief returns once no cpu is still dispatching to the handler, so it can be freed afterwards.
+             * Must not be called from a handler of the same vector.
+             */
             static void removeHandler(interruptHandler* handler, ak::uint8_t interrupt);
+
+            static interruptStatistics getStatistics(ak::uint8_t interrupt);
+            static void resetStatistics();
             
         private:
-            static List<interruptHandler*>* interruptCallbacks[256];
+            /**
+             * @brief two copies per vector, dispatch reads the active one without locking,
+             * add/remove wait until the other copy has no readers left, rebuild it and then flip activeSlot
+             */
+            static interruptVector vectors[256][2];
+            static volatile ak::uint8_t activeSlot[256];
+            static spinLock updateLock;
+
+            static interruptStatistics statistics[256];
+            static void waitForReaders(interruptVector* vector);
+            static bool getSysInfoValue(const char* path, ak::uint64_t* value);
         };
     }
 }
@@ -0,0 +1,41 @@
+//
+//  log.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 17/01/22.
+//
+
+#include "log.h"
+#include <system/console.h>
+#include <system/trace.h>
+
+using namespace Kernel;
+using namespace Kernel::system;
+using namespace pranaOS::ak;
+
+void Kernel::system::log(LogLevel level, const char* __restrict__ format, ...) {
+    va_list args;
+    va_start(args, format);
+    traceManager::record(level, format, args);
+    va_end(args);
+
+    // callers only pay for the record, deferredWork formats and prints it once the cpu is idle.
+    // Errors are printed right away, the system may not get that far
+    if(level == Error)
+        traceManager::drain();
+}
+
+void Kernel::system::print(const char* data, uint32_t length) {
+    char chunk[64];
+
+    while(length > 0) {
+        uint32_t count = length < sizeof(chunk) - 1 ? length : sizeof(chunk) - 1;
+        for(uint32_t i = 0; i < count; i++)
+            chunk[i] = data[i];
+        chunk[count] = '\0';
+
+        bootConsole::write(chunk);
+        data += count;
+        length -= count;
+    }
+}
@@ -0,0 +1,55 @@
+//
+//  pci.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 19/01/22.
+//
+
+#include "pci.h"
+#include <cpu/port.h>
+
+using namespace Kernel;
+using namespace Kernel::core;
+using namespace Kernel::system;
+using namespace pranaOS::ak;
+
+uint32_t pciBus::read(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset) {
+    uint32_t address = 0x80000000 | (bus << 16) | ((device & 0x1F) << 11) | ((function & 0x07) << 8) | (offset & 0xFC);
+    outportl(PCI_CONFIG_ADDRESS, address);
+    return inportl(PCI_CONFIG_DATA);
+}
+
+void pciBus::write(uint8_t bus, uint8_t device, uint8_t function, uint8_t offset, uint32_t value) {
+    uint32_t address = 0x80000000 | (bus << 16) | ((device & 0x1F) << 11) | ((function & 0x07) << 8) | (offset & 0xFC);
+    outportl(PCI_CONFIG_ADDRESS, address);
+    outportl(PCI_CONFIG_DATA, value);
+}
+
+bool pciBus::findDevice(uint8_t classCode, uint8_t subclass, pciDevice* result) {
+    for(uint32_t bus = 0; bus < 256; bus++) {
+        for(uint8_t device = 0; device < 32; device++) {
+            if((read(bus, device, 0, PCI_REG_VENDOR) & 0xFFFF) == 0xFFFF)
+                continue;
+
+            uint8_t functions = (read(bus, device, 0, PCI_REG_HEADER_TYPE) >> 16) & 0x80 ? 8 : 1;
+            for(uint8_t function = 0; function < functions; function++) {
+                if((read(bus, device, function, PCI_REG_VENDOR) & 0xFFFF) == 0xFFFF)
+                    continue;
+
+                uint32_t classInfo = read(bus, device, function, PCI_REG_CLASS);
+                if((classInfo >> 24) != classCode || ((classInfo >> 16) & 0xFF) != subclass)
+                    continue;
+
+                result->bus = bus;
+                result->device = device;
+                result->function = function;
+                result->classCode = classCode;
+                result->subclass = subclass;
+                result->progIf = (classInfo >> 8) & 0xFF;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,50 @@
+//
+//  pci.h
+//  pranaOS
+//
+//  Created by Krisna Pranav on 19/01/22.
+//
+
+#pragma once
+
+#include <ak/types.h>
+
+namespace Kernel {
+    namespace system {
+        #define PCI_CONFIG_ADDRESS 0xCF8
+        #define PCI_CONFIG_DATA 0xCFC
+
+        #define PCI_REG_VENDOR 0x00
+        #define PCI_REG_COMMAND 0x04
+        #define PCI_REG_CLASS 0x08
+        #define PCI_REG_HEADER_TYPE 0x0C
+        #define PCI_REG_BAR0 0x10
+        #define PCI_REG_INTERRUPT 0x3C
+
+        #define PCI_COMMAND_IO 0x01
+        #define PCI_COMMAND_BUS_MASTER 0x04
+
+        struct pciDevice {
+            ak::uint8_t bus;
+            ak::uint8_t device;
+            ak::uint8_t function;
+            ak::uint8_t classCode;
+            ak::uint8_t subclass;
+            ak::uint8_t progIf;
+        };
+
+        /**
+         * @brief configuration space access through the legacy 0xCF8/0xCFC mechanism
+         */
+        class pciBus {
+        public:
+            static ak::uint32_t read(ak::uint8_t bus, ak::uint8_t device, ak::uint8_t function, ak::uint8_t offset);
+            static void write(ak::uint8_t bus, ak::uint8_t device, ak::uint8_t function, ak::uint8_t offset, ak::uint32_t value);
+
+            /**
+             * @brief first function with the given class and subclass, false when there is none
+             */
+            static bool findDevice(ak::uint8_t classCode, ak::uint8_t subclass, pciDevice* result);
+        };
+    }
+}
@@ -0,0 +1,173 @@
+//
+//  serialport.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 17/01/22.
+//
+
+#include "serialport.h"
+
+using namespace Kernel;
+using namespace Kernel::core;
+using namespace pranaOS::ak;
+
+#define UART_DATA 0
+#define UART_INTERRUPT_ENABLE 1
+#define UART_FIFO_CONTROL 2
+#define UART_INTERRUPT_ID 2
+#define UART_LINE_CONTROL 3
+#define UART_MODEM_CONTROL 4
+#define UART_LINE_STATUS 5
+
+#define UART_IER_RECEIVE 0x01
+#define UART_IER_THR_EMPTY 0x02
+#define UART_IIR_MASK 0x0F
+#define UART_IIR_THR_EMPTY 0x02
+#define UART_LSR_THR_EMPTY 0x20
+
+bool serialPort::initialized = false;
+COMPort serialPort::portaddress = COM1;
+
+char serialPort::txBuffer[SERIAL_TX_BUFFER_SIZE];
+volatile uint32_t serialPort::txHead = 0;
+volatile uint32_t serialPort::txTail = 0;
+volatile bool serialPort::txActive = false;
+bool serialPort::interruptMode = false;
+bool serialPort::panicMode = false;
+spinLock serialPort::txLock;
+
+serialInterruptHandler::serialInterruptHandler(uint8_t interrupt)
+: system::interruptHandler(interrupt) { }
+
+uint32_t serialInterruptHandler::handleInterrupt(uint32_t esp) {
+    if((inportb(serialPort::portaddress + UART_INTERRUPT_ID) & UART_IIR_MASK) != UART_IIR_THR_EMPTY)
+        return esp;
+
+    serialPort::txLock.lock();
+    serialPort::transmitBurst();
+    serialPort::txLock.unlock();
+
+    return esp;
+}
+
+int serialPort::serialReceiveReady() {
+    return inportb(portaddress + UART_LINE_STATUS) & 1;
+}
+
+int serialPort::serialSendReady() {
+    return inportb(portaddress + UART_LINE_STATUS) & UART_LSR_THR_EMPTY;
+}
+
+void serialPort::init(COMPort port) {
+    portaddress = port;
+
+    outportb(port + UART_INTERRUPT_ENABLE, 0x00);
+    outportb(port + UART_LINE_CONTROL, 0x80);
+    outportb(port + UART_DATA, 0x03);
+    outportb(port + UART_INTERRUPT_ENABLE, 0x00);
+    outportb(port + UART_LINE_CONTROL, 0x03);
+
+    // enable and clear both fifos, 14 byte trigger level
+    outportb(port + UART_FIFO_CONTROL, 0xC7);
+    outportb(port + UART_MODEM_CONTROL, 0x0B);
+
+    txHead = txTail = 0;
+    txActive = false;
+    initialized = true;
+}
+
+void serialPort::enableInterrupts() {
+    if(!initialized || interruptMode)
+        return;
+
+    uint8_t vector = (portaddress == COM1 || portaddress == COM3) ? COM1_INTERRUPT : COM2_INTERRUPT;
+    interruptMode = (new serialInterruptHandler(vector)) != 0;
+}
+
+char serialPort::read() {
+    while(serialReceiveReady() == 0);
+    return inportb(portaddress);
+}
+
+/**
+ * @brief moves up to one fifo load from the ring to the uart, the caller holds txLock,
+ * turns the thr empty interrupt off once the ring is drained
+ */
+void serialPort::transmitBurst() {
+    uint32_t count = 0;
+    while(txTail != txHead && count < SERIAL_FIFO_BURST) {
+        outportb(portaddress + UART_DATA, txBuffer[txTail % SERIAL_TX_BUFFER_SIZE]);
+        txTail = txTail + 1;
+        count++;
+    }
+
+    bool pending = txTail != txHead;
+    if(pending != txActive) {
+        txActive = pending;
+        outportb(portaddress + UART_INTERRUPT_ENABLE, pending ? UART_IER_THR_EMPTY : 0x00);
+    }
+}
+
+void serialPort::drainSync() {
+    while(txTail != txHead) {
+        while(serialSendReady() == 0);
+        transmitBurst();
+    }
+}
+
+void serialPort::writeSync(char a) {
+    while(serialSendReady() == 0);
+    outportb(portaddress, a);
+}
+
+void serialPort::write(char a) {
+    char str[2] = { a, '\0' };
+    writeStr(str);
+}
+
+void serialPort::writeStr(char* str) {
+    if(!interruptMode || panicMode) {
+        writeStrSync(str);
+        return;
+    }
+
+    uint32_t flags = txLock.lockIrqSave();
+
+    for(int i = 0; str[i] != '\0'; i++) {
+        // ring full, push one fifo load by hand rather than dropping output
+        if(txHead - txTail >= SERIAL_TX_BUFFER_SIZE) {
+            while(serialSendReady() == 0);
+            transmitBurst();
+        }
+
+        txBuffer[txHead % SERIAL_TX_BUFFER_SIZE] = str[i];
+        txHead = txHead + 1;
+    }
+
+    // transmitter idle, prime the fifo and let the interrupt take over from here
+    if(!txActive) {
+        if(serialSendReady())
+            transmitBurst();
+        else {
+            txActive = true;
+            outportb(portaddress + UART_INTERRUPT_ENABLE, UART_IER_THR_EMPTY);
+        }
+    }
+
+    txLock.unlockIrqRestore(flags);
+}
+
+void serialPort::enterPanicMode() {
+    panicMode = true;
+
+    // the lock may be held by the code that crashed, so the ring is drained without it
+    if(interruptMode)
+        drainSync();
+
+    outportb(portaddress + UART_INTERRUPT_ENABLE, 0x00);
+}
+
+void serialPort::writeStrSync(char* str) {
+    for(int i = 0; str[i] != '\0'; i++)
+        writeSync(str[i]);
+}
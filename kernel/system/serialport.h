@@ -2,6 +2,8 @@
 
 #include <ak/types.h>
 #include <core/port.h>
+#include <system/interrupthandler.h>
+#include <tasking/lock.h>
 
 namespace Kernel {
     enum COMPort
@@ -12,6 +14,21 @@ namespace Kernel {
         COM4 = 0x2E8
     };
 
+    #define SERIAL_TX_BUFFER_SIZE 4096
+    #define SERIAL_FIFO_BURST 14
+
+    #define COM1_INTERRUPT 0x24
+    #define COM2_INTERRUPT 0x23
+
+    /**
+     * @brief raises an interrupt whenever the transmit holding register runs empty
+     */
+    class serialInterruptHandler : public system::interruptHandler {
+    public:
+        serialInterruptHandler(ak::uint8_t interrupt);
+        ak::uint32_t handleInterrupt(ak::uint32_t esp);
+    };
+
     class serialPort {
     public:
         static int serialReceiveReady();
@@ -20,11 +37,38 @@ namespace Kernel {
         static bool initialized;
         static void init(COMPort port);
 
+        /**
+         * @brief switches output from busy waiting to the tx ring,
+         * call once the interrupt manager is up
+         */
+        static void enableInterrupts();
+
         static char read();
         static void write(char a);
         static void writeStr(char* str);
 
+        /**
+         * @brief synchronous output for panic paths, drains the ring first
+         * and keeps every following write synchronous
+         */
+        static void enterPanicMode();
+        static void writeStrSync(char* str);
+
     private:
         static COMPort portaddress;
+
+        static char txBuffer[SERIAL_TX_BUFFER_SIZE];
+        static volatile ak::uint32_t txHead;
+        static volatile ak::uint32_t txTail;
+        static volatile bool txActive;
+        static bool interruptMode;
+        static bool panicMode;
+        static spinLock txLock;
+
+        static void writeSync(char a);
+        static void transmitBurst();
+        static void drainSync();
+
+        friend class serialInterruptHandler;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,66 @@
+#include "sysinfo.h"
+
+using namespace Kernel;
+using namespace Kernel::system;
+using namespace pranaOS::ak;
+
+systemInfoManager::providerEntry systemInfoManager::providers[MAX_SYSINFO_PROVIDERS];
+int systemInfoManager::numProviders = 0;
+
+bool systemInfoManager::registerProvider(const char* name, sysInfoProvider provider) {
+    if(numProviders >= MAX_SYSINFO_PROVIDERS)
+        return false;
+
+    providers[numProviders].name = name;
+    providers[numProviders].provider = provider;
+    numProviders++;
+    return true;
+}
+
+bool systemInfoManager::getValue(const char* path, uint64_t* value) {
+    for(int i = 0; i < numProviders; i++) {
+        const char* name = providers[i].name;
+        int len = 0;
+        while(name[len] && name[len] == path[len])
+            len++;
+
+        if(name[len] != '\0')
+            continue;
+
+        if(path[len] == '\0')
+            return providers[i].provider(path + len, value);
+
+        if(path[len] == '.')
+            return providers[i].provider(path + len + 1, value);
+    }
+
+    return false;
+}
+
+bool systemInfoManager::readIndex(const char** path, uint32_t* index) {
+    const char* p = *path;
+    if(*p < '0' || *p > '9')
+        return false;
+
+    uint32_t result = 0;
+    while(*p >= '0' && *p <= '9')
+        result = result * 10 + (*p++ - '0');
+
+    if(*p == '.')
+        p++;
+    else if(*p != '\0')
+        return false;
+
+    *index = result;
+    *path = p;
+    return true;
+}
+
+bool systemInfoManager::isKey(const char* path, const char* key) {
+    while(*key && *path == *key) {
+        path++;
+        key++;
+    }
+
+    return *key == '\0' && *path == '\0';
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <ak/types.h>
+
+namespace Kernel {
+    namespace system {
+        #define MAX_SYSINFO_PROVIDERS 16
+
+        /**
+         * @brief resolves the rest of a property path (after "name.") into a value
+         */
+        typedef bool (*sysInfoProvider)(const char* path, ak::uint64_t* value);
+
+        /**
+         * @brief kernel side of SYSCALL_GET_SYSINFO_VALUE.
+         * Paths are dot separated with numeric indices, for example "interrupts.33.count",
+         * the first component selects the registered provider.
+         */
+        class systemInfoManager {
+        public:
+            static bool registerProvider(const char* name, sysInfoProvider provider);
+            static bool getValue(const char* path, ak::uint64_t* value);
+
+            static bool readIndex(const char** path, ak::uint32_t* index);
+            static bool isKey(const char* path, const char* key);
+
+        private:
+            struct providerEntry {
+                const char* name;
+                sysInfoProvider provider;
+            };
+
+            static providerEntry providers[MAX_SYSINFO_PROVIDERS];
+            static int numProviders;
+        };
+    }
+}
@@ -0,0 +1,327 @@
+//
+//  trace.cpp
+//  pranaOS
+//
+//  Created by Krisna Pranav on 17/01/22.
+//
+
+#include "trace.h"
+#include <cpu/cpu.h>
+#include <system/console.h>
+#include <system/serialport.h>
+
+using namespace Kernel;
+using namespace Kernel::system;
+using namespace pranaOS::ak;
+
+traceRing traceManager::rings[MAX_CPUS];
+spinLock traceManager::drainLock;
+bool traceManager::enabled = true;
+uint32_t traceManager::cyclesPerMs = 0;
+
+static const char* levelNames[] = { "Info", "Warning", "Error" };
+
+/**
+ * @brief bounded output buffer for the record formatter
+ */
+struct lineWriter {
+    char* buffer;
+    uint32_t size;
+    uint32_t length;
+
+    void put(char c) {
+        if(length + 1 < size)
+            buffer[length++] = c;
+    }
+
+    void putString(const char* str) {
+        if(str == 0)
+            str = "(null)";
+        while(*str)
+            put(*str++);
+    }
+
+    void putNumber(uint64_t value, uint32_t base, bool upper, uint32_t width, char pad) {
+        const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+        char tmp[24];
+        uint32_t count = 0;
+
+        do {
+            uint32_t rem;
+            value = divide64(value, base, &rem);
+            tmp[count++] = digits[rem];
+        } while(value);
+
+        while(width > count) {
+            put(pad);
+            width--;
+        }
+        while(count)
+            put(tmp[--count]);
+    }
+};
+
+/**
+ * @brief conversion of one format specifier, record and formatRecord must agree on it
+ */
+struct formatSpec {
+    char pad;
+    uint32_t width;
+    uint32_t longs;
+};
+
+static const char* parseSpec(const char* p, formatSpec* spec) {
+    spec->pad = ' ';
+    spec->width = 0;
+    spec->longs = 0;
+
+    if(*p == '0') {
+        spec->pad = '0';
+        p++;
+    }
+    while(*p >= '0' && *p <= '9')
+        spec->width = spec->width * 10 + (*p++ - '0');
+    while(*p == 'l') {
+        spec->longs++;
+        p++;
+    }
+
+    return p;
+}
+
+static inline bool isWide(char conversion, const formatSpec* spec) {
+    return spec->longs >= 2 && (conversion == 'd' || conversion == 'i' || conversion == 'u' || conversion == 'x' || conversion == 'X');
+}
+
+void traceManager::record(LogLevel level, const char* format, va_list args) {
+    if(!enabled)
+        return;
+
+    uint32_t flags = Cpu::disableInterrupts();
+    uint32_t cpu = Cpu::currentId();
+    traceRing* ring = &rings[cpu];
+
+    uint32_t head = ring->head;
+    if(head - ring->tail >= TRACE_RING_SIZE) {
+        ring->dropped = ring->dropped + 1;
+        Cpu::restoreInterrupts(flags);
+        return;
+    }
+
+    traceRecord* entry = &ring->records[head % TRACE_RING_SIZE];
+    entry->format = format;
+    entry->timestamp = Cpu::readTimestamp();
+    entry->level = level;
+    entry->cpu = cpu;
+
+    uint32_t slot = 0;
+    uint32_t used = 0;
+    formatSpec spec;
+
+    for(const char* p = format; *p; p++) {
+        if(*p != '%')
+            continue;
+
+        p = parseSpec(p + 1, &spec);
+        if(*p == '\0')
+            break;
+        if(*p == '%')
+            continue;
+
+        if(isWide(*p, &spec)) {
+            if(slot + 2 > TRACE_MAX_ARGS)
+                break;
+
+            uint64_t value = va_arg(args, uint64_t);
+            entry->args[slot++] = (uint32_t)value;
+            entry->args[slot++] = (uint32_t)(value >> 32);
+            continue;
+        }
+
+        if(slot == TRACE_MAX_ARGS)
+            break;
+
+        if(*p != 's') {
+            entry->args[slot++] = va_arg(args, uint32_t);
+            continue;
+        }
+
+        // the caller's buffer may be gone by the time the record is drained
+        const char* str = va_arg(args, const char*);
+        if(str == 0)
+            str = "(null)";
+
+        entry->args[slot++] = used < TRACE_STRING_SIZE ? used : TRACE_STRING_SIZE - 1;
+        while(*str && used + 1 < TRACE_STRING_SIZE)
+            entry->strings[used++] = *str++;
+        if(used < TRACE_STRING_SIZE)
+            entry->strings[used++] = '\0';
+    }
+
+    entry->argCount = slot;
+
+    asm volatile ("" ::: "memory");
+    ring->head = head + 1;
+
+    Cpu::restoreInterrupts(flags);
+}
+
+uint32_t traceManager::formatRecord(const traceRecord* record, char* buffer, uint32_t size) {
+    lineWriter out = { buffer, size, 0 };
+    uint32_t arg = 0;
+
+    out.put('[');
+    if(LOG_SHOW_MS && cyclesPerMs)
+        out.putNumber(divide64(record->timestamp, cyclesPerMs), 10, false, 0, ' ');
+    else
+        out.putNumber(record->timestamp, 10, false, 0, ' ');
+    out.putString("] [");
+    out.putString(levelNames[record->level <= Error ? record->level : Error]);
+    out.putString("] ");
+
+    for(const char* p = record->format; *p; p++) {
+        if(*p != '%') {
+            out.put(*p);
+            continue;
+        }
+
+        formatSpec spec;
+        p = parseSpec(p + 1, &spec);
+
+        if(*p == '\0')
+            break;
+        if(*p == '%') {
+            out.put('%');
+            continue;
+        }
+
+        if(isWide(*p, &spec)) {
+            uint64_t value = 0;
+            if(arg + 2 <= record->argCount) {
+                value = record->args[arg] | ((uint64_t)record->args[arg + 1] << 32);
+                arg += 2;
+            }
+
+            if((*p == 'd' || *p == 'i') && (int64_t)value < 0) {
+                out.put('-');
+                value = -(int64_t)value;
+            }
+            out.putNumber(value, (*p == 'x' || *p == 'X') ? 16 : 10, *p == 'X', spec.width, spec.pad);
+            continue;
+        }
+
+        uint32_t value = arg < record->argCount ? record->args[arg++] : 0;
+        switch(*p) {
+            case 'd':
+            case 'i':
+                if((int32_t)value < 0) {
+                    out.put('-');
+                    value = -(int32_t)value;
+                }
+                out.putNumber(value, 10, false, spec.width, spec.pad);
+                break;
+            case 'u':
+                out.putNumber(value, 10, false, spec.width, spec.pad);
+                break;
+            case 'x':
+            case 'X':
+                out.putNumber(value, 16, *p == 'X', spec.width, spec.pad);
+                break;
+            case 'p':
+                out.putString("0x");
+                out.putNumber(value, 16, false, 8, '0');
+                break;
+            case 's':
+                out.putString(value < TRACE_STRING_SIZE ? record->strings + value : "(null)");
+                break;
+            case 'c':
+                out.put((char)value);
+                break;
+            default:
+                out.put('%');
+                out.put(*p);
+                break;
+        }
+    }
+
+    out.put('\n');
+    buffer[out.length] = '\0';
+    return out.length;
+}
+
+uint32_t traceManager::drain(uint32_t maxRecords) {
+    if(!drainLock.tryLock())
+        return 0;
+
+    char line[TRACE_LINE_SIZE];
+    uint32_t done = 0;
+
+    for(uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        traceRing* ring = &rings[cpu];
+        uint32_t dropped = ring->dropped;
+        if(dropped != ring->reportedDrops) {
+            lineWriter out = { line, sizeof(line), 0 };
+            out.putString("trace: cpu ");
+            out.putNumber(cpu, 10, false, 0, ' ');
+            out.putString(" dropped ");
+            out.putNumber(dropped - ring->reportedDrops, 10, false, 0, ' ');
+            out.putString(" records\n");
+            print(line, out.length);
+            ring->reportedDrops = dropped;
+        }
+    }
+
+    while(done < maxRecords) {
+        // oldest pending record over all cpus, so the output stays in time order
+        traceRing* oldest = 0;
+        for(uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+            traceRing* ring = &rings[cpu];
+            if(ring->tail == ring->head)
+                continue;
+
+            asm volatile ("" ::: "memory");
+            if(oldest == 0 || ring->records[ring->tail % TRACE_RING_SIZE].timestamp < oldest->records[oldest->tail % TRACE_RING_SIZE].timestamp)
+                oldest = ring;
+        }
+
+        if(oldest == 0)
+            break;
+
+        uint32_t tail = oldest->tail;
+        traceRecord entry = oldest->records[tail % TRACE_RING_SIZE];
+        asm volatile ("" ::: "memory");
+        oldest->tail = tail + 1;
+
+        print(line, formatRecord(&entry, line, sizeof(line)));
+        done++;
+    }
+
+    drainLock.unlock();
+    return done;
+}
+
+void traceManager::dump() {
+    enabled = false;
+    serialPort::enterPanicMode();
+    bootConsole::setAutoFlush(true);
+
+    char line[TRACE_LINE_SIZE];
+    for(uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        traceRing* ring = &rings[cpu];
+        uint32_t head = ring->head;
+        if(head == 0)
+            continue;
+
+        uint32_t start = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        for(uint32_t i = start; i < head; i++)
+            print(line, formatRecord(&ring->records[i % TRACE_RING_SIZE], line, sizeof(line)));
+    }
+}
+
+void traceManager::setEnabled(bool value) {
+    enabled = value;
+}
+
+void traceManager::setCyclesPerMs(uint32_t cycles) {
+    cyclesPerMs = cycles;
+}
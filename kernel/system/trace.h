@@ -0,0 +1,76 @@
+//
+//  trace.h
+//  pranaOS
+//
+//  Created by Krisna Pranav on 17/01/22.
+//
+
+#pragma once
+
+#include <ak/types.h>
+#include <system/log.h>
+#include <tasking/lock.h>
+#include <stdarg.h>
+
+namespace Kernel {
+    namespace system {
+        #define TRACE_MAX_ARGS 6
+        #define TRACE_RING_SIZE 256
+        #define TRACE_LINE_SIZE 256
+        #define TRACE_STRING_SIZE 64
+
+        /**
+         * @brief one log call, formatted only when the record is drained.
+         * %s arguments are copied into strings (truncated when they do not fit) and their
+         * slot holds the offset, %ll arguments take two slots, low word first
+         */
+        struct traceRecord {
+            const char* format;
+            ak::uint64_t timestamp;
+            ak::uint8_t level;
+            ak::uint8_t argCount;
+            ak::uint16_t cpu;
+            ak::uint32_t args[TRACE_MAX_ARGS];
+            char strings[TRACE_STRING_SIZE];
+        };
+
+        /**
+         * @brief written only by its own cpu with interrupts off, read by the drain
+         */
+        struct traceRing {
+            traceRecord records[TRACE_RING_SIZE];
+            volatile ak::uint32_t head;
+            volatile ak::uint32_t tail;
+            volatile ak::uint32_t dropped;
+            ak::uint32_t reportedDrops;
+        } __attribute__((aligned(64)));
+
+        class traceManager {
+        public:
+            static void record(LogLevel level, const char* format, va_list args);
+
+            /**
+             * @brief formats and prints up to maxRecords pending records in timestamp order,
+             * run in small batches by deferredWork
+             */
+            static ak::uint32_t drain(ak::uint32_t maxRecords = 0xFFFFFFFF);
+
+            /**
+             * @brief prints the last records of every ring synchronously, including already
+             * drained ones, for use after a crash
+             */
+            static void dump();
+
+            static void setEnabled(bool enabled);
+            static void setCyclesPerMs(ak::uint32_t cycles);
+
+        private:
+            static traceRing rings[];
+            static spinLock drainLock;
+            static bool enabled;
+            static ak::uint32_t cyclesPerMs;
+
+            static ak::uint32_t formatRecord(const traceRecord* record, char* buffer, ak::uint32_t size);
+        };
+    }
+}
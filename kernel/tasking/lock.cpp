@@ -0,0 +1,120 @@
+#include "lock.h"
+#include <system/deferred.h>
+
+using namespace Kernel;
+using namespace pranaOS::ak;
+
+void (*mutexLock::yieldHandler)() = 0;
+void (*waitQueue::blockHandler)(waitQueue* queue, uint32_t ticket) = 0;
+void (*waitQueue::wakeHandler)(waitQueue* queue) = 0;
+
+void waitQueue::wait(uint32_t ticket) {
+    __sync_fetch_and_add(&sleepers, 1);
+
+    while (sequence == ticket) {
+        if (blockHandler) {
+            blockHandler(this, ticket);
+            continue;
+        }
+
+        if (!Cpu::interruptsEnabled()) {
+            asm volatile ("pause" ::: "memory");
+            continue;
+        }
+
+        system::deferredWork::run();
+
+        // sti only takes effect after the next instruction, so a wake from an interrupt
+        // between the check and hlt still ends the hlt
+        asm volatile ("cli" ::: "memory");
+        if (sequence == ticket)
+            asm volatile ("sti; hlt" ::: "memory");
+        else
+            asm volatile ("sti" ::: "memory");
+    }
+
+    __sync_fetch_and_sub(&sleepers, 1);
+}
+
+void waitQueue::wake() {
+    __sync_fetch_and_add(&sequence, 1);
+
+    if (wakeHandler && sleepers)
+        wakeHandler(this);
+}
+
+void waitQueue::setHandlers(void (*block)(waitQueue* queue, uint32_t ticket), void (*wakeup)(waitQueue* queue)) {
+    blockHandler = block;
+    wakeHandler = wakeup;
+}
+
+mutexLock::mutexLock() {
+    value = 0;
+    waiters = 0;
+}
+
+bool mutexLock::tryLock() {
+    if (!__sync_bool_compare_and_swap(&value, 0, 1))
+        return false;
+
+    statistics.acquisitions++;
+    return true;
+}
+
+void mutexLock::lock() {
+    if (tryLock())
+        return;
+
+    uint32_t spins = 0;
+    for (int i = 0; i < MUTEX_SPIN_COUNT; i++) {
+        if (value == 0 && __sync_bool_compare_and_swap(&value, 0, 1))
+            break;
+
+        asm volatile ("pause" ::: "memory");
+        spins++;
+    }
+
+    if (spins == MUTEX_SPIN_COUNT) {
+        // registered before the last attempt, so unlock either lets it succeed or wakes us
+        __sync_fetch_and_add(&waiters, 1);
+        while (true) {
+            uint32_t ticket = queue.prepare();
+            if (value == 0 && __sync_bool_compare_and_swap(&value, 0, 1))
+                break;
+
+            queue.wait(ticket);
+        }
+        __sync_fetch_and_sub(&waiters, 1);
+    }
+
+    statistics.acquisitions++;
+    statistics.contentions++;
+    statistics.spins += spins;
+}
+
+void mutexLock::unlock() {
+    __sync_lock_release(&value);
+    __sync_synchronize();
+
+    if (waiters)
+        queue.wake();
+}
+
+bool mutexLock::isLocked() {
+    return value != 0;
+}
+
+lockStatistics mutexLock::getStatistics() {
+    return statistics;
+}
+
+void mutexLock::setYieldHandler(void (*handler)()) {
+    yieldHandler = handler;
+}
+
+void mutexLock::yield() {
+    if (yieldHandler)
+        yieldHandler();
+    else
+        asm volatile ("pause" ::: "memory");
+}
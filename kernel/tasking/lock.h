@@ -1,22 +1,146 @@
 #pragma once
 
 #include <ak/types.h>
-
-/**
- * @brief mutex lock
- */
+#include <cpu/cpu.h>
 
 namespace Kernel {
+    #define MUTEX_SPIN_COUNT 128
+
+    struct lockStatistics {
+        ak::uint32_t acquisitions;
+        ak::uint32_t contentions;
+        ak::uint32_t spins;
+    };
+
+    /**
+     * @brief fair ticket spinlock for short critical sections,
+     * use lockIrqSave when the same lock is taken from interrupt context
+     */
+    class spinLock {
+    private:
+        volatile ak::uint32_t nextTicket = 0;
+        volatile ak::uint32_t nowServing = 0;
+        lockStatistics statistics = {0, 0, 0};
+
+    public:
+        inline void lock()
+        {
+            ak::uint32_t ticket = __sync_fetch_and_add(&nextTicket, 1);
+            ak::uint32_t spins = 0;
+
+            while (nowServing != ticket) {
+                asm volatile ("pause" ::: "memory");
+                spins++;
+            }
+            asm volatile ("" ::: "memory");
+
+            statistics.acquisitions++;
+            if (spins) {
+                statistics.contentions++;
+                statistics.spins += spins;
+            }
+        }
+
+        inline bool tryLock()
+        {
+            ak::uint32_t serving = nowServing;
+            if (!__sync_bool_compare_and_swap(&nextTicket, serving, serving + 1))
+                return false;
+
+            statistics.acquisitions++;
+            return true;
+        }
+
+        inline void unlock()
+        {
+            asm volatile ("" ::: "memory");
+            nowServing = nowServing + 1;
+        }
+
+        inline ak::uint32_t lockIrqSave()
+        {
+            ak::uint32_t flags = Cpu::disableInterrupts();
+            lock();
+            return flags;
+        }
+
+        inline void unlockIrqRestore(ak::uint32_t flags)
+        {
+            unlock();
+            Cpu::restoreInterrupts(flags);
+        }
+
+        inline bool isLocked()
+        {
+            return nowServing != nextTicket;
+        }
+
+        inline lockStatistics getStatistics()
+        {
+            return statistics;
+        }
+    };
+
+    /**
+     * @brief place to sleep until an event. A waiter takes a ticket with prepare before it checks
+     * its condition and only sleeps while no wake happened since, so a wakeup is never lost.
+     * The scheduler installs block and wakeup handlers, until then a waiter runs the deferred
+     * work and halts until the next interrupt (or pauses when interrupts are off)
+     */
+    class waitQueue {
+    private:
+        volatile ak::uint32_t sequence = 0;
+        volatile ak::uint32_t sleepers = 0;
+
+        static void (*blockHandler)(waitQueue* queue, ak::uint32_t ticket);
+        static void (*wakeHandler)(waitQueue* queue);
+
+    public:
+        inline ak::uint32_t prepare()
+        {
+            ak::uint32_t ticket = sequence;
+            asm volatile ("" ::: "memory");
+            return ticket;
+        }
+
+        void wait(ak::uint32_t ticket);
+        void wake();
+
+        /**
+         * @brief block gets the ticket so it can put the thread back when a wake already happened
+         */
+        static void setHandlers(void (*block)(waitQueue* queue, ak::uint32_t ticket), void (*wakeup)(waitQueue* queue));
+    };
+
+    /**
+     * @brief mutex lock for long critical sections, spins for a short while and then
+     * sleeps on its wait queue until unlock wakes it. Not for interrupt context
+     */
     class mutexLock {
 
     private:
-        int value = 0;
+        volatile int value = 0;
+        volatile ak::uint32_t waiters = 0;
+        lockStatistics statistics = {0, 0, 0};
+        waitQueue queue;
+
+        static void (*yieldHandler)();
 
     public:
         mutexLock();
 
         void lock();
+        bool tryLock();
         void unlock();
-        void load();
+        bool isLocked();
+
+        lockStatistics getStatistics();
+
+        static void setYieldHandler(void (*handler)());
+
+        /**
+         * @brief hands the cpu to the scheduler when one is installed, otherwise just pauses
+         */
+        static void yield();
     };
-}
\ No newline at end of file
+}
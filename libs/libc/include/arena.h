@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stddef.h>
+#include <types.h>
+
+namespace pranaOSHeap {
+    #define ARENA_CHUNK_SIZE 64_KB
+
+    struct arenaChunk {
+        arenaChunk* next;
+        uint32_t size;
+        uint32_t reserved[2];
+    };
+
+    /**
+     * @brief bump allocator for objects that all die together. Memory comes from chunks of the
+     * user heap and is only given back all at once, reset() keeps the chunks for the next round.
+     * Destructors are never run and an arena must not be shared between threads.
+     */
+    class Arena {
+    public:
+        Arena(uint32_t chunkSize = ARENA_CHUNK_SIZE);
+        ~Arena();
+
+        inline void* allocate(uint32_t size, uint32_t align = 16) {
+            // new of an empty object still needs a real, distinct address
+            if(size == 0)
+                size = 1;
+
+            uint32_t start = (this->position + align - 1) & ~(align - 1);
+            if(start + size > this->limit)
+                return allocateSlow(size, align);
+
+            this->position = start + size;
+            return (void*)start;
+        }
+
+        /**
+         * @brief forgets every allocation, the chunks are reused from the first one on
+         */
+        void reset();
+
+        /**
+         * @brief forgets every allocation and returns the chunks to the heap
+         */
+        void release();
+
+    private:
+        arenaChunk* first;
+        arenaChunk* current;
+        uint32_t chunkSize;
+        uint32_t position;
+        uint32_t limit;
+
+        /**
+         * @brief moves on to the next chunk that fits, or a new one after the current chunk.
+         * Chunks skipped for being too small are not gone back to before the next reset()
+         */
+        void* allocateSlow(uint32_t size, uint32_t align);
+    };
+}
+
+inline void* operator new(size_t size, pranaOSHeap::Arena& arena) {
+    return arena.allocate(size);
+}
+
+inline void* operator new[](size_t size, pranaOSHeap::Arena& arena) {
+    return arena.allocate(size);
+}
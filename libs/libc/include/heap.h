@@ -1,20 +1,125 @@
 #pragma once
 
 #include <types.h>
+#include <proc.h>
 
 namespace pranaOSHeap {
     uint32_t pageRoundUp(uint32_t address);
     uint32_t pageRoundDown(uint32_t address);
 
     #define HEAP_SIZE 10_MB
+    #define HEAP_INCREASE_SIZE 100_KB
+    #define HEAP_MIN_SPLIT 16
 
+    /* free blocks sit in power of two bins, bin n holds sizes [16 << n, 32 << n) */
+    #define HEAP_BINS 24
+    #define HEAP_BIN_SCAN 8
+
+    /* a free tail larger than this goes back to the kernel, HEAP_INCREASE_SIZE of it is kept */
+    #define HEAP_TRIM_THRESHOLD 256_KB
+
+    /* small requests are served from SLAB_SIZE chunks carved into equal objects,
+       one size class per power of two from SLAB_MIN_OBJECT to SLAB_MAX_OBJECT */
+    #define SLAB_SIZE 16_KB
+    #define SLAB_MIN_OBJECT 16
+    #define SLAB_MAX_OBJECT 2_KB
+    #define SLAB_CLASSES 8
+    #define SLAB_MAP_WORDS ((HEAP_SIZE / SLAB_SIZE + 1 + 31) / 32)
+
+    /**
+     * @brief blocks are laid out back to back, previousSize is the boundary tag that finds the
+     * block in front, next and prev link free blocks within their bin
+     */
     struct memoryHeader {
         memoryHeader* next;
         memoryHeader* prev;
-        bool allocated;
         uint32_t size;
-        size_t size;
-    } __attribute__((packed));
+        uint32_t previousSize : 31;
+        uint32_t allocated : 1;
+    };
+
+    struct slabObject {
+        slabObject* next;
+    };
+
+    /**
+     * @brief start of every slab chunk, objects follow at SLAB_HEADER_SIZE
+     */
+    struct slabChunk {
+        slabChunk* next;
+        slabChunk* prev;
+        slabObject* freeList;
+        uint32_t bumpOffset;
+        uint16_t sizeClass;
+        uint16_t used;
+        uint16_t capacity;
+        bool listed;
+    };
+
+    #define SLAB_HEADER_SIZE ((sizeof(slabChunk) + 15) & ~15)
+
+    /**
+     * @brief chunks with at least one free object, full chunks are unlinked until a free
+     */
+    struct slabClass {
+        slabChunk* partial;
+        slabChunk* empty;
+        uint32_t objectSize;
+    };
+
+    /* there is no thread local storage, threads pick a cache by hashing their stack pointer,
+       so two threads only share one when their stacks collide */
+    #define HEAP_CACHE_SHARDS 8
+    #define HEAP_CACHE_STACK_SHIFT 16
+    #define HEAP_CACHE_BATCH 32
+    #define HEAP_CACHE_LIMIT 64
+
+    /* one allocation in every HEAP_SAMPLE_BYTES allocated bytes records its call site */
+    #define HEAP_SAMPLE_BYTES 64_KB
+    #define HEAP_PROFILE_SITES 64
+
+    struct heapClassStatistics {
+        uint32_t objectSize;
+        uint32_t liveObjects;
+        uint64_t allocations;
+    };
+
+    struct heapSiteStatistics {
+        uint32_t address;
+        uint32_t samples;
+        uint64_t bytes;
+    };
+
+    struct heapStatistics {
+        heapClassStatistics classes[SLAB_CLASSES];
+        uint32_t largeLiveBlocks;
+        uint32_t largeLiveBytes;
+        uint64_t largeAllocations;
+
+        uint32_t inUseBytes;
+        uint32_t peakInUseBytes;
+        uint32_t heapSize;
+        uint32_t peakHeapSize;
+
+        uint64_t allocations;
+        uint64_t allocatedBytes;
+        uint32_t elapsedTicks;
+    };
+
+    /**
+     * @brief per thread free lists in front of the slabs, refilled from and returned to
+     * the central heap HEAP_CACHE_BATCH objects at a time
+     */
+    struct threadCache {
+        DECLARE_LOCK(cache);
+        slabObject* lists[SLAB_CLASSES];
+        uint32_t counts[SLAB_CLASSES];
+
+        uint64_t allocations[SLAB_CLASSES];
+        uint64_t frees[SLAB_CLASSES];
+        uint64_t allocatedBytes;
+        int32_t sampleCountdown;
+    } __attribute__((aligned(64)));
 
     class userHeap {
     public:
@@ -22,16 +127,70 @@ namespace pranaOSHeap {
         static void printMemoryLayout();
 
         static void* malloc(uint32_t size);
+
+        /**
+         * @brief caller is the call site the profile charges, operator new passes its own caller
+         */
+        static void* malloc(uint32_t size, void* caller);
         static void free(void* ptr);
 
         static void* alignedMalloc(uint32_t size, uint32_t align);
         static void alignedFree(void* ptr);
 
+        static void getStatistics(heapStatistics* result);
+
+        /**
+         * @brief sampled call sites sorted by samples, returns how many were written
+         */
+        static int getTopSites(heapSiteStatistics* result, int max);
+        static void dumpProfile();
+
     private:
         static uint32_t startAddress;
         static uint32_t endAddress;
         static uint32_t maxAddress;
 
         static memoryHeader* firstHeader;
+        static memoryHeader* lastHeader;
+        static memoryHeader* bins[HEAP_BINS];
+        static uint32_t binMap;
+
+        static slabClass classes[SLAB_CLASSES];
+        static uint32_t slabBase;
+        static uint32_t slabMap[SLAB_MAP_WORDS];
+        static threadCache caches[HEAP_CACHE_SHARDS];
+
+        static uint32_t inUseBytes;
+        static uint32_t peakInUseBytes;
+        static uint32_t peakHeapSize;
+        static uint32_t largeLiveBlocks;
+        static uint32_t largeLiveBytes;
+        static uint64_t largeAllocations;
+        static uint64_t largeBytes;
+        static int32_t largeSampleCountdown;
+        static uint32_t startTicks;
+        static heapSiteStatistics sites[HEAP_PROFILE_SITES];
+
+        static void* allocateBlock(uint32_t size, uint32_t align);
+        static void freeBlock(void* ptr);
+        static bool expandHeap(uint32_t size);
+        static void trimHeap();
+
+        static uint32_t binIndex(uint32_t size);
+        static void insertFree(memoryHeader* header);
+        static void removeFree(memoryHeader* header);
+        static memoryHeader* findFree(uint32_t size);
+        static memoryHeader* splitBlock(memoryHeader* header, uint32_t offset);
+
+        static void* slabAllocate(uint32_t sizeClass);
+        static void slabFree(slabChunk* chunk, void* ptr);
+        static slabChunk* slabOf(void* ptr);
+
+        static threadCache* currentCache();
+        static void fillCache(threadCache* cache, uint32_t sizeClass);
+        static void drainCache(threadCache* cache, uint32_t sizeClass, uint32_t count);
+
+        static void recordSample(void* caller, uint32_t size);
+        static bool chargeLarge(void* block, uint32_t size);
     };
-}
\ No newline at end of file
+}
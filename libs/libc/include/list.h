@@ -1,5 +1,7 @@
 #pragma once
 
+#include <arena.h>
+
 namespace pranaOSList {
 
     template <typename T>
@@ -12,12 +14,18 @@ namespace pranaOSList {
     };
 
     template <typename T>
-    class list {
+    class List {
     public:
-        list() : head_(0), tail_(0), size_(0)
+        List() : head_(0), tail_(0), size_(0), arena_(0)
+        {}
+
+        /**
+         * @brief nodes come from the arena and are only released with it
+         */
+        List(pranaOSHeap::Arena* arena) : head_(0), tail_(0), size_(0), arena_(arena)
         {}
 
-        ~list() {
+        ~List() {
             this->clear();
         }
 
@@ -41,8 +49,11 @@ namespace pranaOSList {
         listNode<T>* head_;
         listNode<T>* tail_;
         int size_;
+        pranaOSHeap::Arena* arena_;
+
         listNode<T>* insertInternal(const T &e, listNode<T>* pos);
         void removeInternal(listNode<T> *pos);
+        void freeNode(listNode<T> *pos);
 
     public:
         class iterator {
@@ -86,7 +97,7 @@ using namespace pranaOSList;
 
 template <typename T>
 listNode<T>* List<T>::insertInternal(const T &e, listNode<T>* pos) {
-    listNode<T> *n = new listNode<T>(e);
+    listNode<T> *n = arena_ ? new (*arena_) listNode<T>(e) : new listNode<T>(e);
     size_++;
 
     n->next = pos;
@@ -130,11 +141,19 @@ void List<T>::removeInternal(listNode<T> *pos) {
 			head_ = pos->next;
 		if(pos == tail_)
 			tail_ = pos->prev;
-		delete pos;
+		freeNode(pos);
 		size_--;
 	}
 }
 
+template <typename T>
+void List<T>::freeNode(listNode<T> *pos) {
+    if(arena_)
+        pos->~listNode<T>();
+    else
+        delete pos;
+}
+
 template <typename T>
 void List<T>::remove(int index) {
     listNode<T>* cur = head_;
@@ -151,13 +170,13 @@ void List<T>::remove(const T &e) {
 }
 
 template <typename T>
-void List<T>::Clear() {
+void List<T>::clear() {
     listNode<T>* current( head_ );
 
     while(current)
     {
         listNode<T>* next( current->next );
-        delete current;
+        freeNode(current);
         current = next;
     }
     size_ = 0; 
@@ -6,11 +6,11 @@
 using namespace pranaOSHeap;
  
 void *operator new(size_t size) {
-    return userHeap::malloc(size);
+    return userHeap::malloc(size, __builtin_return_address(0));
 }
  
 void *operator new[](size_t size) {
-    return userHeap::malloc(size);
+    return userHeap::malloc(size, __builtin_return_address(0));
 }
 
 void* operator new(size_t size, void* ptr) {
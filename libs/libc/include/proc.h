@@ -10,7 +10,7 @@ namespace pranaOSProc {
 
     #define DECLARE_LOCK(name) volatile int name ## Locked
     #define LOCK(name) \
-	    while (name ## Locked == 1) asm("pause"); \
+	    while (!__sync_bool_compare_and_swap(&name ## Locked, 0, 1)) asm("pause"); \
 	    __sync_synchronize();
     #define UNLOCK(name) \
 	    __sync_synchronize(); \
@@ -32,6 +32,28 @@ namespace pranaOSShared {
         char name[VFS_NAME_LENGTH]; 
     };
 
+    #define VFS_DIRENT_DIRECTORY (1 << 0)
+
+    /**
+     * @brief record returned by SYSCALL_GET_DIRENTS, records are packed back to back and
+     * recordLength (a multiple of 4) is the offset of the next one, name is null terminated
+     */
+    struct vfsDirent {
+        uint16_t recordLength;
+        uint8_t nameLength;
+        uint8_t flags;
+        uint32_t size;
+
+        uint8_t sec;
+        uint8_t min;
+        uint8_t hour;
+        uint8_t day;
+        uint8_t month;
+        uint16_t year;
+
+        char name[];
+    } __attribute__((packed));
+
     #define KEYPACKET_START 0xFF
     enum KEYPACKET_FLAGS {
         noFlags = 0,
@@ -54,6 +54,14 @@ namespace pranaOSSyscall {
         SYSCALL_LISTING_ENTRY,
         SYSCALL_END_LISTING,
         SYSCALL_GET_SYSINFO_VALUE,
+        SYSCALL_OPEN,
+        SYSCALL_READ,
+        SYSCALL_WRITE,
+        SYSCALL_SEEK,
+        SYSCALL_CLOSE,
+        SYSCALL_GET_DIRENTS,
+        SYSCALL_MMAP,
+        SYSCALL_MUNMAP,
     };
 
     int DoSyscall(unsigned int intNum, unsigned int arg1 = 0, unsigned int arg2 = 0, unsigned int arg3 = 0, unsigned int arg4 = 0, unsigned int arg5 = 0);
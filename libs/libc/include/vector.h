@@ -1,6 +1,7 @@
 #pragma once
 
 #include <types.h>
+#include <arena.h>
 
 namespace pranaOSVector {
 
@@ -8,77 +9,91 @@ namespace pranaOSVector {
     class Vector {
     public:
         Vector() {
-            this->size = 0;
-            this->capacity = 0;
-            this->buffer = 0;
+            this->size_ = 0;
+            this->capacity_ = 0;
+            this->buffer_ = 0;
+            this->arena_ = 0;
         }
+
+        /**
+         * @brief storage comes from the arena, outgrown buffers are left to it until its reset
+         */
+        Vector(pranaOSHeap::Arena* arena) {
+            this->size_ = 0;
+            this->capacity_ = 0;
+            this->buffer_ = 0;
+            this->arena_ = arena;
+        }
+
         ~Vector() {
             this->clear();
         }
 
         int size() {
-            return this->size;
+            return this->size_;
         }
 
         void push_back(const T& item) {
-            if(this->capacity == 0)
+            if(this->capacity_ == 0)
                 reserve(10);
-            else if(this->size == this->capacity)
-                reserve(2 * this->size);
+            else if(this->size_ == this->capacity_)
+                reserve(2 * this->size_);
             
-            this->buffer[this->size] = item;
-            this->size++;
+            this->buffer_[this->size_] = item;
+            this->size_++;
         }
 
         void pop_back() {
-            this->size--;
+            this->size_--;
         }
 
         void clear() {
-            this->capacity = 0;
-            this->size = 0;
+            this->capacity_ = 0;
+            this->size_ = 0;
 
-            if(this->buffer)
-                delete this->buffer;
-            this->buffer = 0;
+            if(this->buffer_ && this->arena_ == 0)
+                delete[] this->buffer_;
+            this->buffer_ = 0;
         }
 
         T& getAt(int n) {
-            return this->buffer[n];
+            return this->buffer_[n];
         }
 
         T& operator[](int n) {
-            return this->buffer[n];
+            return this->buffer_[n];
         }
 
         T* data() {
-            return this->buffer;
+            return this->buffer_;
         }
 
         typedef T* iterator;
         iterator begin() {
-            return this->buffer;
+            return this->buffer_;
         }
 
         iterator end() {
-            return this->buffer + this->size;
+            return this->buffer_ + this->size_;
         }
 
     private:
-        uint32_t size = 0;
-        uint32_t capacity = 0;
-        T* buffer = 0;
+        uint32_t size_ = 0;
+        uint32_t capacity_ = 0;
+        T* buffer_ = 0;
+        pranaOSHeap::Arena* arena_ = 0;
 
         void reserve(int capacity)
         {
-            T* newBuf = new T[capacity];
-            memcpy(newBuf, this->buffer, sizeof(T) * this->size);
+            T* newBuf = this->arena_ ? new (*this->arena_) T[capacity] : new T[capacity];
+            for(uint32_t i = 0; i < this->size_; i++)
+                newBuf[i] = this->buffer_[i];
 
-            this->capacity = capacity;
+            this->capacity_ = capacity;
             
-            if(this->buffer)
-                delete this->buffer;
-            this->buffer = newBuf;
+            if(this->buffer_ && this->arena_ == 0)
+                delete[] this->buffer_;
+            this->buffer_ = newBuf;
         }
     };
-}
\ No newline at end of file
+}
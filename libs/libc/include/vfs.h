@@ -5,6 +5,22 @@
 #include <shared.h>
 
 namespace pranaOSVfs {
+    #define VFS_OPEN_READ (1 << 0)
+    #define VFS_OPEN_WRITE (1 << 1)
+    #define VFS_OPEN_CREATE (1 << 2)
+    #define VFS_OPEN_TRUNCATE (1 << 3)
+    #define VFS_OPEN_DIRECTORY (1 << 4)
+    #define VFS_DIRENT_BUFFER_SIZE 2048
+
+    #define VFS_MAP_READ (1 << 0)
+    #define VFS_MAP_WRITE (1 << 1)
+
+    enum seekOrigin {
+        seekSet,
+        seekCurrent,
+        seekEnd
+    };
+
     int readFile(char* filename, uint8_t* buffer, uint32_t offset = 0, uint32_t len = -1);
     int writeFile(char* filename, uint8_t* buffer, uint32_t len, bool create = true);
 
@@ -15,7 +31,51 @@ namespace pranaOSVfs {
     int createDirectory(char* path);
 
     uint32_t getFileSize(char* filename);
-    List<vfsEntry> dirListing(char* path);
+    List<pranaOSShared::vfsEntry> dirListing(char* path);
 
     bool ejectDisk(char* path);
+
+    /**
+     * @brief handle based access, the path is resolved once at open and the kernel keeps
+     * the file position (and its cluster) with the handle, returns -1 on failure
+     */
+    int open(char* path, int flags = VFS_OPEN_READ);
+    int read(int handle, uint8_t* buffer, uint32_t len);
+    int write(int handle, uint8_t* buffer, uint32_t len);
+    int seek(int handle, int32_t offset, seekOrigin origin = seekSet);
+    int close(int handle);
+
+    /**
+     * @brief fills buffer with packed vfsDirent records from a handle opened with
+     * VFS_OPEN_DIRECTORY, returns the bytes used, 0 at the end and -1 on failure
+     */
+    int getDirents(int handle, uint8_t* buffer, uint32_t size);
+
+    /**
+     * @brief maps length bytes of an open file starting at offset (a multiple of 4 KB),
+     * pages are read in on first access, writes stay private to the mapping.
+     * Returns 0 on failure.
+     */
+    void* mmap(int handle, uint32_t offset, uint32_t length, int protection = VFS_MAP_READ);
+    int munmap(void* address, uint32_t length);
+
+    /**
+     * @brief walks a directory one entry at a time without building a list,
+     * the kernel is only asked for the next batch once the current one is used up.
+     * next() returns 0 at the end, the entry stays valid until the following call.
+     */
+    class dirIterator {
+    public:
+        dirIterator(char* path);
+        ~dirIterator();
+
+        bool valid();
+        pranaOSShared::vfsDirent* next();
+
+    private:
+        int handle;
+        uint32_t position;
+        uint32_t used;
+        uint8_t buffer[VFS_DIRENT_BUFFER_SIZE];
+    };
 }
\ No newline at end of file
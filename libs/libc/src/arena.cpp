@@ -0,0 +1,68 @@
+#include <arena.h>
+#include <heap.h>
+
+using namespace pranaOSHeap;
+
+Arena::Arena(uint32_t chunkSize) {
+    this->first = 0;
+    this->current = 0;
+    this->chunkSize = chunkSize;
+    this->position = 0;
+    this->limit = 0;
+}
+
+Arena::~Arena() {
+    this->release();
+}
+
+void* Arena::allocateSlow(uint32_t size, uint32_t align) {
+    uint32_t needed = sizeof(arenaChunk) + size + align;
+
+    // after a reset the old chunks come around again, ones that are too small are skipped.
+    // the walk only goes forward from the current chunk, so a skipped chunk stays unused
+    // for the rest of the round even when a later, smaller request would fit, until reset()
+    arenaChunk* chunk = this->current ? this->current->next : this->first;
+    while(chunk && chunk->size < needed)
+        chunk = chunk->next;
+
+    if(chunk == 0) {
+        uint32_t chunkBytes = needed > this->chunkSize ? needed : this->chunkSize;
+        chunk = (arenaChunk*)userHeap::malloc(chunkBytes);
+        if(chunk == 0)
+            return 0;
+
+        chunk->size = chunkBytes;
+        if(this->current) {
+            chunk->next = this->current->next;
+            this->current->next = chunk;
+        }
+        else {
+            chunk->next = this->first;
+            this->first = chunk;
+        }
+    }
+
+    this->current = chunk;
+    this->position = (uint32_t)chunk + sizeof(arenaChunk);
+    this->limit = (uint32_t)chunk + chunk->size;
+
+    return this->allocate(size, align);
+}
+
+void Arena::reset() {
+    this->current = 0;
+    this->position = 0;
+    this->limit = 0;
+}
+
+void Arena::release() {
+    arenaChunk* chunk = this->first;
+    while(chunk) {
+        arenaChunk* next = chunk->next;
+        userHeap::free(chunk);
+        chunk = next;
+    }
+
+    this->first = 0;
+    this->reset();
+}
@@ -0,0 +1,699 @@
+#include <heap.h>
+#include <proc.h>
+#include <log.h>
+#include <syscall.h>
+
+using namespace pranaOSHeap;
+using namespace pranaOSSyscall;
+using namespace pranaOSLog;
+
+uint32_t userHeap::startAddress = 0;
+uint32_t userHeap::endAddress = 0;
+uint32_t userHeap::maxAddress = 0;
+memoryHeader* userHeap::firstHeader = 0;
+memoryHeader* userHeap::lastHeader = 0;
+memoryHeader* userHeap::bins[HEAP_BINS];
+uint32_t userHeap::binMap = 0;
+
+slabClass userHeap::classes[SLAB_CLASSES];
+uint32_t userHeap::slabBase = 0;
+uint32_t userHeap::slabMap[SLAB_MAP_WORDS];
+threadCache userHeap::caches[HEAP_CACHE_SHARDS];
+
+uint32_t userHeap::inUseBytes = 0;
+uint32_t userHeap::peakInUseBytes = 0;
+uint32_t userHeap::peakHeapSize = 0;
+uint32_t userHeap::largeLiveBlocks = 0;
+uint32_t userHeap::largeLiveBytes = 0;
+uint64_t userHeap::largeAllocations = 0;
+uint64_t userHeap::largeBytes = 0;
+int32_t userHeap::largeSampleCountdown = 0;
+uint32_t userHeap::startTicks = 0;
+heapSiteStatistics userHeap::sites[HEAP_PROFILE_SITES];
+
+static DECLARE_LOCK(heap);
+static DECLARE_LOCK(profile);
+
+uint32_t pranaOSHeap::pageRoundUp(uint32_t address) {
+    if((address & 0xFFFFF000) != address) {
+        address &= 0xFFFFF000;
+        address += 0x1000;
+    }
+    return address;
+}
+
+uint32_t pranaOSHeap::pageRoundDown(uint32_t address) {
+    return address & 0xFFFFF000;
+}
+
+static inline uint32_t highestBit(uint32_t value) {
+    uint32_t index;
+    asm ("bsr %1, %0" : "=r" (index) : "rm" (value));
+    return index;
+}
+
+static inline uint32_t lowestBit(uint32_t value) {
+    uint32_t index;
+    asm ("bsf %1, %0" : "=r" (index) : "rm" (value));
+    return index;
+}
+
+static inline memoryHeader* nextBlock(memoryHeader* header) {
+    return (memoryHeader*)((uint32_t)header + sizeof(memoryHeader) + header->size);
+}
+
+static inline memoryHeader* previousBlock(memoryHeader* header) {
+    return (memoryHeader*)((uint32_t)header - header->previousSize - sizeof(memoryHeader));
+}
+
+void userHeap::initialize() {
+    startAddress = DoSyscall(SYSCALL_GET_HEAP_START);
+    endAddress = DoSyscall(SYSCALL_GET_HEAP_END);
+    maxAddress = startAddress + HEAP_SIZE;
+
+    for(int i = 0; i < HEAP_BINS; i++)
+        bins[i] = 0;
+    binMap = 0;
+
+    firstHeader = (memoryHeader*)startAddress;
+    firstHeader->size = endAddress - startAddress - sizeof(memoryHeader);
+    firstHeader->previousSize = 0;
+    lastHeader = firstHeader;
+    insertFree(firstHeader);
+
+    slabBase = startAddress & ~(SLAB_SIZE - 1);
+    for(int i = 0; i < SLAB_MAP_WORDS; i++)
+        slabMap[i] = 0;
+
+    for(int i = 0; i < HEAP_CACHE_SHARDS; i++) {
+        caches[i].cacheLocked = 0;
+        caches[i].allocatedBytes = 0;
+        caches[i].sampleCountdown = HEAP_SAMPLE_BYTES;
+        for(int j = 0; j < SLAB_CLASSES; j++) {
+            caches[i].lists[j] = 0;
+            caches[i].counts[j] = 0;
+            caches[i].allocations[j] = 0;
+            caches[i].frees[j] = 0;
+        }
+    }
+
+    for(int i = 0; i < HEAP_PROFILE_SITES; i++)
+        sites[i].address = 0;
+
+    largeSampleCountdown = HEAP_SAMPLE_BYTES;
+    peakHeapSize = endAddress - startAddress;
+    startTicks = DoSyscall(SYSCALL_GET_TICKS);
+
+    for(int i = 0; i < SLAB_CLASSES; i++) {
+        classes[i].partial = 0;
+        classes[i].empty = 0;
+        classes[i].objectSize = SLAB_MIN_OBJECT << i;
+    }
+}
+
+void userHeap::printMemoryLayout() {
+    memoryHeader* header = firstHeader;
+    while(true) {
+        print("[%x] size: %d %s\n", (uint32_t)header, header->size, header->allocated ? "allocated" : "free");
+        if(header == lastHeader)
+            break;
+        header = nextBlock(header);
+    }
+}
+
+uint32_t userHeap::binIndex(uint32_t size) {
+    if(size < 2 * HEAP_MIN_SPLIT)
+        return 0;
+
+    uint32_t bin = highestBit(size) - 4;
+    return bin < HEAP_BINS ? bin : HEAP_BINS - 1;
+}
+
+void userHeap::insertFree(memoryHeader* header) {
+    uint32_t bin = binIndex(header->size);
+
+    header->allocated = false;
+    header->prev = 0;
+    header->next = bins[bin];
+    if(bins[bin])
+        bins[bin]->prev = header;
+
+    bins[bin] = header;
+    binMap |= (1 << bin);
+}
+
+void userHeap::removeFree(memoryHeader* header) {
+    uint32_t bin = binIndex(header->size);
+
+    if(header->prev)
+        header->prev->next = header->next;
+    else
+        bins[bin] = header->next;
+    if(header->next)
+        header->next->prev = header->prev;
+
+    if(bins[bin] == 0)
+        binMap &= ~(1 << bin);
+}
+
+/**
+ * @brief a few blocks of the size's own bin are checked first, any block of a higher bin
+ * fits so those are taken from the head without looking
+ */
+memoryHeader* userHeap::findFree(uint32_t size) {
+    uint32_t bin = binIndex(size);
+
+    memoryHeader* header = bins[bin];
+    for(int i = 0; header != 0 && i < HEAP_BIN_SCAN; i++, header = header->next)
+        if(header->size >= size)
+            return header;
+
+    uint32_t higher = binMap & ~((2 << bin) - 1);
+    if(higher == 0)
+        return 0;
+
+    return bins[lowestBit(higher)];
+}
+
+/**
+ * @brief cuts a block at offset bytes into its payload, returns the new block behind it
+ */
+memoryHeader* userHeap::splitBlock(memoryHeader* header, uint32_t offset) {
+    memoryHeader* split = (memoryHeader*)((uint32_t)header + sizeof(memoryHeader) + offset);
+    split->size = header->size - offset - sizeof(memoryHeader);
+    split->previousSize = offset;
+    header->size = offset;
+
+    if(header == lastHeader)
+        lastHeader = split;
+    else
+        nextBlock(split)->previousSize = split->size;
+
+    return split;
+}
+
+bool userHeap::expandHeap(uint32_t size) {
+    uint32_t increase = size + 2 * sizeof(memoryHeader);
+    if(increase < HEAP_INCREASE_SIZE)
+        increase = HEAP_INCREASE_SIZE;
+
+    uint32_t newEnd = pageRoundUp(endAddress + increase);
+    if(newEnd > maxAddress)
+        newEnd = maxAddress;
+    if(newEnd <= endAddress)
+        return false;
+
+    DoSyscall(SYSCALL_SET_HEAP_SIZE, newEnd);
+    if(DoSyscall(SYSCALL_GET_HEAP_END) < newEnd)
+        return false;
+
+    if(!lastHeader->allocated) {
+        removeFree(lastHeader);
+        lastHeader->size += newEnd - endAddress;
+        insertFree(lastHeader);
+    }
+    else {
+        memoryHeader* header = (memoryHeader*)endAddress;
+        header->size = newEnd - endAddress - sizeof(memoryHeader);
+        header->previousSize = lastHeader->size;
+        lastHeader = header;
+        insertFree(header);
+    }
+
+    endAddress = newEnd;
+    if(endAddress - startAddress > peakHeapSize)
+        peakHeapSize = endAddress - startAddress;
+
+    return true;
+}
+
+void userHeap::trimHeap() {
+    if(lastHeader->allocated || lastHeader->size < HEAP_TRIM_THRESHOLD)
+        return;
+
+    uint32_t newEnd = pageRoundUp((uint32_t)lastHeader + sizeof(memoryHeader) + HEAP_INCREASE_SIZE);
+    if(newEnd >= endAddress)
+        return;
+
+    DoSyscall(SYSCALL_SET_HEAP_SIZE, newEnd);
+    if(DoSyscall(SYSCALL_GET_HEAP_END) != newEnd)
+        return;
+
+    removeFree(lastHeader);
+    lastHeader->size = newEnd - (uint32_t)lastHeader - sizeof(memoryHeader);
+    insertFree(lastHeader);
+    endAddress = newEnd;
+}
+
+void* userHeap::allocateBlock(uint32_t size, uint32_t align) {
+    size = (size + 15) & ~15;
+
+    // payloads are always 16 byte aligned, bigger alignments need room to cut off a front block
+    uint32_t needed = size;
+    if(align > 16)
+        needed += align + sizeof(memoryHeader) + HEAP_MIN_SPLIT;
+
+    memoryHeader* header = findFree(needed);
+    if(header == 0)
+        return 0;
+
+    removeFree(header);
+
+    uint32_t payload = (uint32_t)header + sizeof(memoryHeader);
+    if(align > 16 && (payload & (align - 1))) {
+        uint32_t aligned = (payload + sizeof(memoryHeader) + HEAP_MIN_SPLIT + align - 1) & ~(align - 1);
+        memoryHeader* split = splitBlock(header, aligned - sizeof(memoryHeader) - payload);
+
+        insertFree(header);
+        header = split;
+    }
+
+    if(header->size >= size + sizeof(memoryHeader) + HEAP_MIN_SPLIT)
+        insertFree(splitBlock(header, size));
+
+    header->allocated = true;
+
+    inUseBytes += header->size;
+    if(inUseBytes > peakInUseBytes)
+        peakInUseBytes = inUseBytes;
+
+    return (void*)((uint32_t)header + sizeof(memoryHeader));
+}
+
+void userHeap::freeBlock(void* ptr) {
+    memoryHeader* header = (memoryHeader*)((uint32_t)ptr - sizeof(memoryHeader));
+    if((uint32_t)header < startAddress || (uint32_t)ptr >= endAddress || !header->allocated)
+        return;
+
+    header->allocated = false;
+    inUseBytes -= header->size;
+
+    if(header != lastHeader) {
+        memoryHeader* next = nextBlock(header);
+        if(!next->allocated) {
+            removeFree(next);
+            header->size += sizeof(memoryHeader) + next->size;
+            if(next == lastHeader)
+                lastHeader = header;
+        }
+    }
+
+    if(header != firstHeader) {
+        memoryHeader* prev = previousBlock(header);
+        if(!prev->allocated) {
+            removeFree(prev);
+            prev->size += sizeof(memoryHeader) + header->size;
+            if(header == lastHeader)
+                lastHeader = prev;
+            header = prev;
+        }
+    }
+
+    if(header != lastHeader)
+        nextBlock(header)->previousSize = header->size;
+
+    insertFree(header);
+
+    if(header == lastHeader)
+        trimHeap();
+}
+
+slabChunk* userHeap::slabOf(void* ptr) {
+    uint32_t address = (uint32_t)ptr;
+    if(address < slabBase || address >= maxAddress)
+        return 0;
+
+    uint32_t index = (address - slabBase) / SLAB_SIZE;
+    if(!(slabMap[index / 32] & (1 << (index % 32))))
+        return 0;
+
+    return (slabChunk*)(slabBase + index * SLAB_SIZE);
+}
+
+static inline void slabLink(slabClass* cls, slabChunk* chunk) {
+    chunk->prev = 0;
+    chunk->next = cls->partial;
+    if(cls->partial)
+        cls->partial->prev = chunk;
+    cls->partial = chunk;
+    chunk->listed = true;
+}
+
+static inline void slabUnlink(slabClass* cls, slabChunk* chunk) {
+    if(chunk->prev)
+        chunk->prev->next = chunk->next;
+    else
+        cls->partial = chunk->next;
+    if(chunk->next)
+        chunk->next->prev = chunk->prev;
+    chunk->listed = false;
+}
+
+void* userHeap::slabAllocate(uint32_t sizeClass) {
+    slabClass* cls = &classes[sizeClass];
+    slabChunk* chunk = cls->partial;
+
+    if(chunk == 0) {
+        chunk = cls->empty;
+        cls->empty = 0;
+
+        if(chunk == 0) {
+            chunk = (slabChunk*)allocateBlock(SLAB_SIZE, SLAB_SIZE);
+            if(chunk == 0 && expandHeap(2 * SLAB_SIZE))
+                chunk = (slabChunk*)allocateBlock(SLAB_SIZE, SLAB_SIZE);
+            if(chunk == 0)
+                return 0;
+
+            uint32_t index = ((uint32_t)chunk - slabBase) / SLAB_SIZE;
+            slabMap[index / 32] |= (1 << (index % 32));
+
+            chunk->sizeClass = sizeClass;
+            chunk->capacity = (SLAB_SIZE - SLAB_HEADER_SIZE) / cls->objectSize;
+        }
+
+        // objects are handed out front to back until the chunk has been used up once
+        chunk->freeList = 0;
+        chunk->bumpOffset = SLAB_HEADER_SIZE;
+        chunk->used = 0;
+        slabLink(cls, chunk);
+    }
+
+    void* object;
+    if(chunk->freeList) {
+        object = chunk->freeList;
+        chunk->freeList = chunk->freeList->next;
+    }
+    else {
+        object = (void*)((uint32_t)chunk + chunk->bumpOffset);
+        chunk->bumpOffset += cls->objectSize;
+    }
+
+    if(++chunk->used == chunk->capacity)
+        slabUnlink(cls, chunk);
+
+    return object;
+}
+
+void userHeap::slabFree(slabChunk* chunk, void* ptr) {
+    slabClass* cls = &classes[chunk->sizeClass];
+
+    slabObject* object = (slabObject*)ptr;
+    object->next = chunk->freeList;
+    chunk->freeList = object;
+
+    if(!chunk->listed)
+        slabLink(cls, chunk);
+
+    if(--chunk->used > 0)
+        return;
+
+    // keep one empty chunk per class so a malloc/free loop does not churn the block list
+    slabUnlink(cls, chunk);
+    if(cls->empty == 0) {
+        cls->empty = chunk;
+        return;
+    }
+
+    uint32_t index = ((uint32_t)chunk - slabBase) / SLAB_SIZE;
+    slabMap[index / 32] &= ~(1 << (index % 32));
+    freeBlock(chunk);
+}
+
+static inline uint32_t sizeClassOf(uint32_t size) {
+    uint32_t sizeClass = 0;
+    uint32_t objectSize = SLAB_MIN_OBJECT;
+    while(objectSize < size) {
+        objectSize <<= 1;
+        sizeClass++;
+    }
+    return sizeClass;
+}
+
+threadCache* userHeap::currentCache() {
+    uint32_t esp;
+    asm volatile ("mov %%esp, %0" : "=r" (esp));
+
+    return &caches[(((esp >> HEAP_CACHE_STACK_SHIFT) * 2654435761u) >> 16) % HEAP_CACHE_SHARDS];
+}
+
+void userHeap::fillCache(threadCache* cache, uint32_t sizeClass) {
+    LOCK(heap);
+    for(uint32_t i = 0; i < HEAP_CACHE_BATCH; i++) {
+        slabObject* object = (slabObject*)slabAllocate(sizeClass);
+        if(object == 0)
+            break;
+
+        object->next = cache->lists[sizeClass];
+        cache->lists[sizeClass] = object;
+        cache->counts[sizeClass]++;
+    }
+    UNLOCK(heap);
+}
+
+void userHeap::drainCache(threadCache* cache, uint32_t sizeClass, uint32_t count) {
+    LOCK(heap);
+    for(uint32_t i = 0; i < count && cache->lists[sizeClass]; i++) {
+        slabObject* object = cache->lists[sizeClass];
+        cache->lists[sizeClass] = object->next;
+        cache->counts[sizeClass]--;
+
+        slabFree(slabOf(object), object);
+    }
+    UNLOCK(heap);
+}
+
+void userHeap::recordSample(void* caller, uint32_t size) {
+    uint32_t address = (uint32_t)caller;
+    uint32_t slot = ((address >> 2) * 2654435761u) % HEAP_PROFILE_SITES;
+
+    LOCK(profile);
+    for(int i = 0; i < HEAP_PROFILE_SITES; i++) {
+        heapSiteStatistics* site = &sites[(slot + i) % HEAP_PROFILE_SITES];
+        if(site->address == 0) {
+            site->address = address;
+            site->samples = 0;
+            site->bytes = 0;
+        }
+
+        if(site->address == address) {
+            site->samples++;
+            site->bytes += size;
+            break;
+        }
+    }
+    UNLOCK(profile);
+}
+
+/**
+ * @brief bookkeeping for large blocks, called with the heap lock held, true when this
+ * allocation should be sampled
+ */
+bool userHeap::chargeLarge(void* block, uint32_t size) {
+    if(block == 0)
+        return false;
+
+    largeAllocations++;
+    largeBytes += size;
+    largeLiveBlocks++;
+    largeLiveBytes += ((memoryHeader*)((uint32_t)block - sizeof(memoryHeader)))->size;
+
+    largeSampleCountdown -= size;
+    if(largeSampleCountdown > 0)
+        return false;
+
+    largeSampleCountdown += HEAP_SAMPLE_BYTES;
+    if(largeSampleCountdown <= 0)
+        largeSampleCountdown = HEAP_SAMPLE_BYTES;
+    return true;
+}
+
+void* userHeap::malloc(uint32_t size) {
+    return malloc(size, __builtin_return_address(0));
+}
+
+void* userHeap::malloc(uint32_t size, void* caller) {
+    if(size == 0)
+        return 0;
+
+    bool sample;
+    void* result;
+
+    if(size <= SLAB_MAX_OBJECT) {
+        uint32_t sizeClass = sizeClassOf(size);
+        threadCache* cache = currentCache();
+
+        LOCK(cache->cache);
+        if(cache->lists[sizeClass] == 0)
+            fillCache(cache, sizeClass);
+
+        slabObject* object = cache->lists[sizeClass];
+        sample = false;
+        if(object) {
+            cache->lists[sizeClass] = object->next;
+            cache->counts[sizeClass]--;
+
+            cache->allocations[sizeClass]++;
+            cache->allocatedBytes += size;
+            cache->sampleCountdown -= size;
+            if(cache->sampleCountdown <= 0) {
+                cache->sampleCountdown += HEAP_SAMPLE_BYTES;
+                sample = true;
+            }
+        }
+        UNLOCK(cache->cache);
+
+        result = object;
+    }
+    else {
+        LOCK(heap);
+
+        result = allocateBlock(size, 0);
+        if(result == 0 && expandHeap(size))
+            result = allocateBlock(size, 0);
+
+        sample = chargeLarge(result, size);
+        UNLOCK(heap);
+    }
+
+    if(sample)
+        recordSample(caller, size);
+
+    return result;
+}
+
+void userHeap::free(void* ptr) {
+    if(ptr == 0)
+        return;
+
+    // the map bit of a chunk with live objects never changes, so this needs no heap lock
+    slabChunk* chunk = slabOf(ptr);
+    if(chunk) {
+        uint32_t sizeClass = chunk->sizeClass;
+        threadCache* cache = currentCache();
+
+        LOCK(cache->cache);
+        slabObject* object = (slabObject*)ptr;
+        object->next = cache->lists[sizeClass];
+        cache->lists[sizeClass] = object;
+        cache->frees[sizeClass]++;
+
+        if(++cache->counts[sizeClass] > HEAP_CACHE_LIMIT)
+            drainCache(cache, sizeClass, HEAP_CACHE_BATCH);
+        UNLOCK(cache->cache);
+        return;
+    }
+
+    LOCK(heap);
+
+    memoryHeader* header = (memoryHeader*)((uint32_t)ptr - sizeof(memoryHeader));
+    if((uint32_t)header >= startAddress && (uint32_t)ptr < endAddress && header->allocated) {
+        largeLiveBlocks--;
+        largeLiveBytes -= header->size;
+        freeBlock(ptr);
+    }
+
+    UNLOCK(heap);
+}
+
+void* userHeap::alignedMalloc(uint32_t size, uint32_t align) {
+    if(size == 0)
+        return 0;
+
+    LOCK(heap);
+
+    void* result = allocateBlock(size, align);
+    if(result == 0 && expandHeap(size + align))
+        result = allocateBlock(size, align);
+
+    bool sample = chargeLarge(result, size);
+    UNLOCK(heap);
+
+    if(sample)
+        recordSample(__builtin_return_address(0), size);
+
+    return result;
+}
+
+void userHeap::alignedFree(void* ptr) {
+    free(ptr);
+}
+
+void userHeap::getStatistics(heapStatistics* result) {
+    for(int i = 0; i < SLAB_CLASSES; i++) {
+        result->classes[i].objectSize = SLAB_MIN_OBJECT << i;
+        result->classes[i].liveObjects = 0;
+        result->classes[i].allocations = 0;
+    }
+    result->allocations = 0;
+    result->allocatedBytes = 0;
+
+    // objects are often freed into another thread's cache, only the sums are meaningful
+    for(int i = 0; i < HEAP_CACHE_SHARDS; i++) {
+        threadCache* cache = &caches[i];
+
+        LOCK(cache->cache);
+        for(int j = 0; j < SLAB_CLASSES; j++) {
+            result->classes[j].liveObjects += cache->allocations[j] - cache->frees[j];
+            result->classes[j].allocations += cache->allocations[j];
+            result->allocations += cache->allocations[j];
+        }
+        result->allocatedBytes += cache->allocatedBytes;
+        UNLOCK(cache->cache);
+    }
+
+    LOCK(heap);
+    result->largeLiveBlocks = largeLiveBlocks;
+    result->largeLiveBytes = largeLiveBytes;
+    result->largeAllocations = largeAllocations;
+    result->inUseBytes = inUseBytes;
+    result->peakInUseBytes = peakInUseBytes;
+    result->heapSize = endAddress - startAddress;
+    result->peakHeapSize = peakHeapSize;
+    result->allocations += largeAllocations;
+    result->allocatedBytes += largeBytes;
+    UNLOCK(heap);
+
+    result->elapsedTicks = DoSyscall(SYSCALL_GET_TICKS) - startTicks;
+}
+
+int userHeap::getTopSites(heapSiteStatistics* result, int max) {
+    int count = 0;
+
+    LOCK(profile);
+    for(int i = 0; i < HEAP_PROFILE_SITES; i++) {
+        if(sites[i].address == 0)
+            continue;
+
+        // insertion into the sorted result, max is small
+        int position = count < max ? count++ : max;
+        while(position > 0 && result[position - 1].samples < sites[i].samples) {
+            if(position < max)
+                result[position] = result[position - 1];
+            position--;
+        }
+        if(position < max)
+            result[position] = sites[i];
+    }
+    UNLOCK(profile);
+
+    return count;
+}
+
+void userHeap::dumpProfile() {
+    heapStatistics stats;
+    getStatistics(&stats);
+
+    print("heap: size %d KB (peak %d KB), in use %d KB (peak %d KB)\n", stats.heapSize / 1024, stats.peakHeapSize / 1024, stats.inUseBytes / 1024, stats.peakInUseBytes / 1024);
+    print("heap: %d allocations, %d KB in %d ticks\n", (uint32_t)stats.allocations, (uint32_t)(stats.allocatedBytes / 1024), stats.elapsedTicks);
+
+    for(int i = 0; i < SLAB_CLASSES; i++) {
+        heapClassStatistics* cls = &stats.classes[i];
+        print("class %d: live %d (%d bytes), %d allocations\n", cls->objectSize, cls->liveObjects, cls->liveObjects * cls->objectSize, (uint32_t)cls->allocations);
+    }
+    print("large: live %d (%d bytes), %d allocations\n", stats.largeLiveBlocks, stats.largeLiveBytes, (uint32_t)stats.largeAllocations);
+
+    heapSiteStatistics top[10];
+    int count = getTopSites(top, 10);
+    for(int i = 0; i < count; i++)
+        print("site %x: %d samples, ~%d KB\n", top[i].address, top[i].samples, top[i].samples * (HEAP_SAMPLE_BYTES / 1024));
+}
@@ -0,0 +1,79 @@
+#include <vfs.h>
+#include <syscall.h>
+
+using namespace pranaOSVfs;
+using namespace pranaOSSyscall;
+
+int pranaOSVfs::open(char* path, int flags) {
+    return DoSyscall(SYSCALL_OPEN, (uint32_t)path, flags);
+}
+
+int pranaOSVfs::read(int handle, uint8_t* buffer, uint32_t len) {
+    return DoSyscall(SYSCALL_READ, handle, (uint32_t)buffer, len);
+}
+
+int pranaOSVfs::write(int handle, uint8_t* buffer, uint32_t len) {
+    return DoSyscall(SYSCALL_WRITE, handle, (uint32_t)buffer, len);
+}
+
+int pranaOSVfs::seek(int handle, int32_t offset, seekOrigin origin) {
+    return DoSyscall(SYSCALL_SEEK, handle, (uint32_t)offset, origin);
+}
+
+int pranaOSVfs::close(int handle) {
+    return DoSyscall(SYSCALL_CLOSE, handle);
+}
+
+void* pranaOSVfs::mmap(int handle, uint32_t offset, uint32_t length, int protection) {
+    return (void*)DoSyscall(SYSCALL_MMAP, handle, offset, length, protection);
+}
+
+int pranaOSVfs::munmap(void* address, uint32_t length) {
+    return DoSyscall(SYSCALL_MUNMAP, (uint32_t)address, length);
+}
+
+int pranaOSVfs::getDirents(int handle, uint8_t* buffer, uint32_t size) {
+    return DoSyscall(SYSCALL_GET_DIRENTS, handle, (uint32_t)buffer, size);
+}
+
+dirIterator::dirIterator(char* path) {
+    this->handle = open(path, VFS_OPEN_READ | VFS_OPEN_DIRECTORY);
+    this->position = 0;
+    this->used = 0;
+}
+
+dirIterator::~dirIterator() {
+    if(this->handle >= 0)
+        close(this->handle);
+}
+
+bool dirIterator::valid() {
+    return this->handle >= 0;
+}
+
+pranaOSShared::vfsDirent* dirIterator::next() {
+    if(this->handle < 0)
+        return 0;
+
+    while(true) {
+        if(this->position >= this->used) {
+            int result = getDirents(this->handle, this->buffer, sizeof(this->buffer));
+            if(result <= 0)
+                return 0;
+
+            this->used = result;
+            this->position = 0;
+        }
+
+        pranaOSShared::vfsDirent* entry = (pranaOSShared::vfsDirent*)(this->buffer + this->position);
+
+        // a zero or overlong record would never advance, treat it as the end of this batch
+        if(entry->recordLength == 0 || entry->recordLength > this->used - this->position) {
+            this->position = this->used;
+            continue;
+        }
+
+        this->position += entry->recordLength;
+        return entry;
+    }
+}
@@ -0,0 +1,184 @@
+//
+//  memoperator_bench.cpp
+//  pranaOS
+//
+//  host microbenchmark for ak::memOperator, compares the tiered
+//  implementations with and without the SSE2 tier against the old byte loops.
+//
+//  build: g++ -O2 -fno-builtin -fno-tree-loop-distribute-patterns -fno-tree-vectorize -o memoperator_bench tests/ak/memoperator_bench.cpp
+//  run:   ./memoperator_bench
+//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../../ak/memoperator.cpp"
+
+static void* byteMemcpy(void* dstptr, const void* srcptr, uint32_t size) {
+    unsigned char* dst = (unsigned char*) dstptr;
+    const unsigned char* src = (const unsigned char*) srcptr;
+
+    for (uint32_t i = 0; i < size; i++)
+        dst[i] = src[i];
+
+    return dstptr;
+}
+
+static void* byteMemset(void* bufptr, char value, uint32_t size) {
+    unsigned char* buf = (unsigned char*) bufptr;
+
+    for (uint32_t i = 0; i < size; i++)
+        buf[i] = (unsigned char) value;
+
+    return bufptr;
+}
+
+static void* byteMemmove(void* dstptr, const void* srcptr, uint32_t size) {
+    unsigned char* dst = (unsigned char*) dstptr;
+    const unsigned char* src = (const unsigned char*) srcptr;
+
+    if (dst < src) {
+        for (uint32_t i = 0; i < size; i++)
+            dst[i] = src[i];
+    } else {
+        for (uint32_t i = size; i != 0; i--)
+            dst[i-1] = src[i-1];
+    }
+
+    return dstptr;
+}
+
+static int byteMemcmp(const void* aptr, const void* bptr, uint32_t size) {
+    const unsigned char* a = (const unsigned char*) aptr;
+    const unsigned char* b = (const unsigned char*) bptr;
+
+    for (uint32_t i = 0; i < size; i++) {
+        if (a[i] < b[i])
+            return -1;
+        else if (b[i] < a[i])
+            return 1;
+    }
+
+    return 0;
+}
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static volatile int sink;
+
+enum benchOp {
+    opMemcpy,
+    opMemset,
+    opMemmove,
+    opMemcmp
+};
+
+static double run(benchOp op, bool baseline, unsigned char* a, unsigned char* b, uint32_t size) {
+    uint32_t iterations = (256u << 20) / size;
+    if (iterations == 0)
+        iterations = 1;
+
+    double start = now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        switch (op) {
+            case opMemcpy:
+                baseline ? byteMemcpy(a, b, size) : memOperator::memcpy(a, b, size);
+                break;
+            case opMemset:
+                baseline ? byteMemset(a, (char)i, size) : memOperator::memset(a, (char)i, size);
+                break;
+            case opMemmove:
+                baseline ? byteMemmove(a + 8, a, size) : memOperator::memmove(a + 8, a, size);
+                break;
+            case opMemcmp:
+                sink += baseline ? byteMemcmp(a, b, size) : memOperator::memcmp(a, b, size);
+                break;
+        }
+    }
+    double elapsed = now() - start;
+
+    return ((double)size * iterations) / elapsed / (1 << 20);
+}
+
+static bool verify(unsigned char* a, unsigned char* b, uint32_t size) {
+    for (uint32_t off = 0; off < 16; off += 3) {
+        for (uint32_t i = 0; i < size; i++)
+            b[i] = (unsigned char)(i * 7 + off);
+
+        memOperator::memcpy(a + off, b + 1, size);
+        if (byteMemcmp(a + off, b + 1, size) != 0)
+            return false;
+
+        memOperator::memset(a + off, 0x5A, size);
+        for (uint32_t i = 0; i < size; i++)
+            if (a[off + i] != 0x5A)
+                return false;
+
+        for (uint32_t i = 0; i < size + 16; i++)
+            a[i] = b[i] = (unsigned char)(i * 13);
+        memOperator::memmove(a + off + 1, a + off, size);
+        byteMemmove(b + off + 1, b + off, size);
+        if (byteMemcmp(a, b, size + 16) != 0)
+            return false;
+        memOperator::memmove(a + off, a + off + 1, size);
+        byteMemmove(b + off, b + off + 1, size);
+        if (byteMemcmp(a, b, size + 16) != 0)
+            return false;
+
+        if (size > 0) {
+            b[size - 1] ^= 1;
+            if (memOperator::memcmp(a, b, size) != byteMemcmp(a, b, size))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+int main() {
+    const uint32_t maxSize = 1 << 20;
+    unsigned char* a = (unsigned char*) aligned_alloc(64, maxSize + 64);
+    unsigned char* b = (unsigned char*) aligned_alloc(64, maxSize + 64);
+    const char* names[] = { "memcpy", "memset", "memmove", "memcmp" };
+
+    for (int sse2 = 0; sse2 <= 1; sse2++) {
+        sse2 ? memOperator::enableSSE2() : memOperator::disableSSE2();
+
+        for (uint32_t size = 0; size <= MEMOP_SSE2_SIZE + 4096; size++) {
+            if (!verify(a, b, size)) {
+                printf("verification failed for size %u%s\n", size, sse2 ? " with sse2" : "");
+                return 1;
+            }
+        }
+    }
+
+    printf("%-8s %10s %14s %14s %14s %8s\n", "op", "size", "bytes MB/s", "tiered MB/s", "sse2 MB/s", "speedup");
+
+    for (int op = opMemcpy; op <= opMemcmp; op++) {
+        for (uint32_t size = 16; size <= maxSize; size <<= 2) {
+            for (uint32_t i = 0; i < size; i++)
+                a[i] = b[i] = (unsigned char) i;
+
+            double base = run((benchOp)op, true, a, b, size);
+
+            memOperator::disableSSE2();
+            double fast = run((benchOp)op, false, a, b, size);
+
+            memOperator::enableSSE2();
+            double sse2 = run((benchOp)op, false, a, b, size);
+
+            double best = sse2 > fast ? sse2 : fast;
+            printf("%-8s %10u %14.0f %14.0f %14.0f %7.2fx\n", names[op], size, base, fast, sse2, best / base);
+        }
+    }
+
+    free(a);
+    free(b);
+    return 0;
+}
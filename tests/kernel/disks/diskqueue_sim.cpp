@@ -0,0 +1,152 @@
+//
+//  diskqueue_sim.cpp
+//  pranaOS
+//
+//  host simulator for Kernel::diskQueue, replays concurrent readers against
+//  a seek cost model and compares plain fifo dispatch with the C-LOOK queue.
+//
+//  build: g++ -O2 -I . -I kernel -o diskqueue_sim tests/kernel/disks/diskqueue_sim.cpp
+//  run:   ./diskqueue_sim
+//
+
+namespace pranaOS { namespace ak { } }
+namespace ak { using namespace pranaOS::ak; }
+
+#include "../../../kernel/disks/diskqueue.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define SIM_DISK_SECTORS (8u << 20)
+#define SIM_READERS 8
+#define SIM_CHUNK 8
+#define SIM_FILE_SECTORS 2048
+
+/**
+ * @brief rough model of a rotating disk: seek time grows with the square root of the distance,
+ * every command pays controller overhead plus rotational latency unless it continues the last one
+ */
+struct seekModel {
+    uint32_t head;
+    double elapsedMs;
+    uint32_t commands;
+    uint32_t sectors;
+
+    double cost(uint32_t lba, uint32_t count) {
+        double ms = 0.05;
+        if (lba != head) {
+            uint32_t distance = lba > head ? lba - head : head - lba;
+            ms += 1.0 + 8.0 * sqrt((double)distance / SIM_DISK_SECTORS) + 4.17;
+        }
+        ms += count * 0.005;
+
+        head = lba + count;
+        commands++;
+        sectors += count;
+        return ms;
+    }
+};
+
+struct reader {
+    uint32_t start;
+    uint32_t next;
+    uint32_t end;
+    uint32_t stride;
+    unsigned char buffer[SIM_CHUNK * DISK_SECTOR_SIZE];
+};
+
+static seekModel model;
+static diskQueue* queue;
+static reader readers[SIM_READERS];
+
+static char simDispatch(void* context, uint32_t lba, uint32_t count, diskIoVec* vectors, uint32_t vectorCount, bool write) {
+    model.elapsedMs += model.cost(lba, count);
+    return 0;
+}
+
+static void readerDone(diskRequest* request, void* context) {
+    reader* r = (reader*)context;
+    r->next += r->stride;
+    if (r->next < r->end)
+        queue->submit(r->next, SIM_CHUNK, r->buffer, false, readerDone, r);
+}
+
+/**
+ * @brief baseline, one request per reader served strictly in arrival order
+ */
+static void runFifo() {
+    uint32_t order[SIM_READERS * 2];
+    uint32_t head = 0, tail = 0;
+
+    for (uint32_t i = 0; i < SIM_READERS; i++)
+        order[tail++ % (SIM_READERS * 2)] = i;
+
+    while (head != tail) {
+        reader* r = &readers[order[head++ % (SIM_READERS * 2)]];
+        model.elapsedMs += model.cost(r->next, SIM_CHUNK);
+
+        r->next += r->stride;
+        if (r->next < r->end)
+            order[tail++ % (SIM_READERS * 2)] = r - readers;
+    }
+}
+
+static void runQueue() {
+    for (uint32_t i = 0; i < SIM_READERS; i++)
+        queue->submit(readers[i].next, SIM_CHUNK, readers[i].buffer, false, readerDone, &readers[i]);
+
+    while (queue->process(1) != 0);
+}
+
+/**
+ * @brief separate: every reader streams its own file somewhere on the disk,
+ * shared: all readers walk the same file in interleaved chunks
+ */
+static void setup(bool shared, uint32_t seed) {
+    srand(seed);
+    for (uint32_t i = 0; i < SIM_READERS; i++) {
+        reader* r = &readers[i];
+        if (shared) {
+            r->start = 1000000 + i * SIM_CHUNK;
+            r->end = 1000000 + SIM_FILE_SECTORS * SIM_READERS;
+            r->stride = SIM_CHUNK * SIM_READERS;
+        } else {
+            r->start = (rand() % (SIM_DISK_SECTORS / SIM_CHUNK - SIM_FILE_SECTORS)) * SIM_CHUNK;
+            r->end = r->start + SIM_FILE_SECTORS;
+            r->stride = SIM_CHUNK;
+        }
+        r->next = r->start;
+    }
+
+    model = seekModel { 0, 0.0, 0, 0 };
+}
+
+static void report(const char* name, bool shared) {
+    setup(shared, 42);
+    runFifo();
+    seekModel fifo = model;
+
+    setup(shared, 42);
+    queue = new diskQueue(simDispatch, 0);
+    runQueue();
+    seekModel clook = model;
+    diskQueueStatistics stats = queue->getStatistics();
+    delete queue;
+
+    if (fifo.sectors != clook.sectors) {
+        printf("%s: sector count mismatch %u vs %u\n", name, fifo.sectors, clook.sectors);
+        exit(1);
+    }
+
+    printf("%-10s %10s %10.1f ms %8u cmds %8.1f MB/s\n", name, "fifo", fifo.elapsedMs, fifo.commands, fifo.sectors / 2048.0 / (fifo.elapsedMs / 1000));
+    printf("%-10s %10s %10.1f ms %8u cmds %8.1f MB/s  (%u requests, %u merged, %.2fx)\n", name, "c-look", clook.elapsedMs, clook.commands,
+        clook.sectors / 2048.0 / (clook.elapsedMs / 1000), stats.requests, stats.merged, fifo.elapsedMs / clook.elapsedMs);
+}
+
+int main() {
+    printf("%u readers, %u sector chunks, %u sectors per reader\n\n", SIM_READERS, SIM_CHUNK, SIM_FILE_SECTORS);
+    report("separate", false);
+    report("shared", true);
+    return 0;
+}
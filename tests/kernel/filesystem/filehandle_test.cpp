@@ -0,0 +1,218 @@
+//
+//  filehandle_test.cpp
+//  pranaOS
+//
+//  host test for Kernel::fileHandleTable against a small in memory filesystem
+//  that behaves like fat: an empty file has id 0 and gets one on its first write,
+//  truncating it to 0 gives the id back.
+//
+//  build: g++ -O2 -I tests/kernel/host -I . -I kernel -o filehandle_test tests/kernel/filesystem/filehandle_test.cpp
+//  run:   ./filehandle_test
+//
+
+namespace pranaOS { namespace ak { } }
+namespace ak { using namespace pranaOS::ak; }
+
+#include "../../../kernel/system/sysinfo.cpp"
+#include "../../../kernel/tasking/lock.cpp"
+#include "../../../kernel/filesystem/vfs.cpp"
+#include "../../../kernel/filesystem/dentrycache.cpp"
+#include "../../../kernel/filesystem/filehandle.cpp"
+
+#include <stdio.h>
+#include <string.h>
+
+void Kernel::system::deferredWork::run() { }
+void Kernel::readAhead::reset(readAheadState* state) { }
+
+#define TEST_FILES 8
+#define TEST_ROOT 1
+
+struct testFile {
+    char name[DENTRY_NAME_LENGTH + 1];
+    vfsInode inode;
+};
+
+class testFileSystem : public virtualFileSystem {
+public:
+    testFile files[TEST_FILES];
+    int numFiles = 0;
+    uint32_t nextId = 100;
+    int lookups = 0;
+
+    // stands in for the directory entry position a real driver keeps for an empty file
+    const char* pendingName = 0;
+
+    bool getRoot(vfsInode* result) override {
+        result->id = TEST_ROOT;
+        result->parent = 0;
+        result->size = 0;
+        result->isDirectory = true;
+        return true;
+    }
+
+    bool lookup(vfsInode* directory, const char* name, uint32_t nameLength, vfsInode* result) override {
+        lookups++;
+        testFile* file = find(name, nameLength);
+        if(directory->id != TEST_ROOT || file == 0)
+            return false;
+
+        *result = file->inode;
+        return true;
+    }
+
+    bool create(vfsInode* directory, const char* name, uint32_t nameLength, bool isDirectory, vfsInode* result) override {
+        if(directory->id != TEST_ROOT || numFiles == TEST_FILES || nameLength > DENTRY_NAME_LENGTH)
+            return false;
+
+        testFile* file = &files[numFiles++];
+        memcpy(file->name, name, nameLength);
+        file->name[nameLength] = '\0';
+        file->inode.id = 0;
+        file->inode.parent = TEST_ROOT;
+        file->inode.size = 0;
+        file->inode.isDirectory = isDirectory;
+
+        *result = file->inode;
+        return true;
+    }
+
+    bool truncate(vfsInode* inode, uint32_t size) override {
+        testFile* file = byId(inode->id);
+        if(file == 0 || size != 0)
+            return false;
+
+        file->inode.id = 0;
+        file->inode.size = 0;
+        *inode = file->inode;
+        return true;
+    }
+
+    int read(vfsInode* inode, vfsCursor* cursor, uint8_t* buffer, uint32_t length) override {
+        memset(buffer, 'x', length);
+        cursor->offset += length;
+        return length;
+    }
+
+    // an empty file is only known by its id 0, like a fat entry without a first cluster
+    int write(vfsInode* inode, vfsCursor* cursor, uint8_t* buffer, uint32_t length) override {
+        testFile* file = inode->id ? byId(inode->id) : byName(inode);
+        if(file == 0)
+            return -1;
+
+        if(file->inode.id == 0)
+            file->inode.id = nextId++;
+
+        cursor->offset += length;
+        if(cursor->offset > file->inode.size)
+            file->inode.size = cursor->offset;
+
+        *inode = file->inode;
+        return length;
+    }
+
+private:
+    testFile* find(const char* name, uint32_t nameLength) {
+        for(int i = 0; i < numFiles; i++)
+            if(strlen(files[i].name) == nameLength && memcmp(files[i].name, name, nameLength) == 0)
+                return &files[i];
+
+        return 0;
+    }
+
+    testFile* byId(uint32_t id) {
+        for(int i = 0; i < numFiles; i++)
+            if(files[i].inode.id == id)
+                return &files[i];
+
+        return 0;
+    }
+
+    testFile* byName(vfsInode* inode) {
+        return pendingName ? find(pendingName, strlen(pendingName)) : 0;
+    }
+};
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if(!(condition)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while(0)
+
+static testFileSystem fs;
+static fileHandleTable table;
+static uint8_t buffer[64];
+
+static uint32_t sizeOf(const char* path) {
+    int handle = table.open(path, VFS_OPEN_READ);
+    if(handle < 0)
+        return 0xFFFFFFFF;
+
+    uint32_t size = table.seek(handle, 0, vfsSeekEnd);
+    table.close(handle);
+    return size;
+}
+
+// the dentry created with the file still holds id 0, the reopen has to see the written size
+static void testWriteThenReopen() {
+    int handle = table.open("/a.txt", VFS_OPEN_WRITE | VFS_OPEN_CREATE);
+    CHECK(handle >= 0);
+
+    fs.pendingName = "a.txt";
+    CHECK(table.write(handle, buffer, 10) == 10);
+    fs.pendingName = 0;
+    CHECK(table.close(handle) == 0);
+
+    int lookups = fs.lookups;
+    CHECK(sizeOf("/a.txt") == 10);
+    CHECK(fs.lookups == lookups);
+}
+
+// truncating back to id 0 must only touch its own entry, not every other empty file
+static void testTruncateKeepsOtherFiles() {
+    int handle = table.open("/b.txt", VFS_OPEN_WRITE | VFS_OPEN_CREATE);
+    CHECK(handle >= 0);
+    table.close(handle);
+
+    handle = table.open("/c.txt", VFS_OPEN_WRITE | VFS_OPEN_CREATE);
+    fs.pendingName = "c.txt";
+    table.write(handle, buffer, 20);
+    fs.pendingName = 0;
+    table.close(handle);
+
+    handle = table.open("/c.txt", VFS_OPEN_WRITE | VFS_OPEN_TRUNCATE);
+    CHECK(handle >= 0);
+
+    // b.txt is open and empty at the same time as c.txt, the two must not share state
+    int other = table.open("/b.txt", VFS_OPEN_WRITE);
+    CHECK(other >= 0);
+    fs.pendingName = "b.txt";
+    CHECK(table.write(other, buffer, 5) == 5);
+    fs.pendingName = 0;
+    table.close(other);
+
+    table.close(handle);
+
+    CHECK(sizeOf("/c.txt") == 0);
+    CHECK(sizeOf("/b.txt") == 5);
+    CHECK(sizeOf("/a.txt") == 10);
+}
+
+int main() {
+    vfsManager::mount(&fs);
+
+    testWriteThenReopen();
+    testTruncateKeepsOtherFiles();
+
+    if(failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all file handle checks passed\n");
+    return 0;
+}
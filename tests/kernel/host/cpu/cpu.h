@@ -0,0 +1,26 @@
+//
+//  cpu.h
+//  pranaOS
+//
+//  host stand-in for kernel/cpu/cpu.h, put tests/kernel/host before kernel
+//  on the include path. The real header moves eflags through 32 bit
+//  registers, which the 64 bit host assembler rejects. Host tests are single
+//  threaded with interrupts off, so locks never have anything to wait for.
+//
+
+#pragma once
+
+#include <ak/types.h>
+
+namespace Kernel {
+        #define MAX_CPUS 8
+
+        class Cpu {
+        public:
+            static inline ak::uint32_t currentId() { return 0; }
+            static inline ak::uint64_t readTimestamp() { return 0; }
+            static inline ak::uint32_t disableInterrupts() { return 0; }
+            static inline void restoreInterrupts(ak::uint32_t flags) { }
+            static inline bool interruptsEnabled() { return false; }
+        };
+}
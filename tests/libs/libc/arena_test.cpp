@@ -0,0 +1,278 @@
+//
+//  arena_test.cpp
+//  pranaOS
+//
+//  host test for pranaOSHeap::Arena and the arena backed List and Vector, the
+//  chunks come from userHeap which is served from a static block like in heap_test.cpp
+//  so the 32 bit addresses the arena works with stay valid on the host.
+//
+//  build: g++ -O2 -no-pie -fpermissive -w -D__KERNEL__ -I libs/libc/include -o arena_test tests/libs/libc/arena_test.cpp
+//  run:   ./arena_test
+//
+
+#include <types.h>
+
+using namespace pranaOSTypes;
+
+namespace pranaOSsystemInfo {
+    struct sharedSystemInfo;
+}
+using pranaOSsystemInfo::sharedSystemInfo;
+
+#include "../../../libs/libc/src/heap.cpp"
+#include "../../../libs/libc/src/arena.cpp"
+#include <list.h>
+#include <vector.h>
+
+extern "C" int printf(const char* format, ...);
+extern "C" int vprintf(const char* format, __builtin_va_list args);
+
+using namespace pranaOSHeap;
+using namespace pranaOSSyscall;
+using namespace pranaOSVector;
+
+alignas(SLAB_SIZE) static unsigned char heapBlock[4 << 20];
+static uint32_t heapEnd = 0;
+
+int pranaOSSyscall::DoSyscall(uint32_t intNum, uint32_t arg1, uint32_t, uint32_t, uint32_t, uint32_t) {
+    if(heapEnd == 0)
+        heapEnd = (uint32_t)(unsigned long)heapBlock + 1_MB;
+
+    switch(intNum) {
+        case SYSCALL_GET_HEAP_START:
+            return (uint32_t)(unsigned long)heapBlock;
+        case SYSCALL_GET_HEAP_END:
+            return heapEnd;
+        case SYSCALL_SET_HEAP_SIZE:
+            heapEnd = arg1;
+            return 1;
+    }
+
+    return 0;
+}
+
+void pranaOSLog::print(const char* format, ...) {
+    __builtin_va_list args;
+    __builtin_va_start(args, format);
+    vprintf(format, args);
+    __builtin_va_end(args);
+}
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if(!(condition)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while(0)
+
+/**
+ * @brief live objects and large blocks, every arena chunk is one of them
+ */
+static uint32_t liveAllocations() {
+    heapStatistics statistics;
+    userHeap::getStatistics(&statistics);
+
+    uint32_t live = statistics.largeLiveBlocks;
+    for(int i = 0; i < SLAB_CLASSES; i++)
+        live += statistics.classes[i].liveObjects;
+
+    return live;
+}
+
+static bool inside(void* pointer, void* start, uint32_t size) {
+    return (unsigned long)pointer >= (unsigned long)start && (unsigned long)pointer < (unsigned long)start + size;
+}
+
+static void testAllocate() {
+    uint32_t before = liveAllocations();
+    Arena arena(4_KB);
+
+    unsigned char* a = (unsigned char*)arena.allocate(10);
+    unsigned char* b = (unsigned char*)arena.allocate(10);
+    unsigned char* c = (unsigned char*)arena.allocate(0);
+    unsigned char* d = (unsigned char*)arena.allocate(0);
+    unsigned char* e = (unsigned char*)arena.allocate(1, 64);
+
+    CHECK(a != 0 && b != 0 && c != 0 && d != 0 && e != 0);
+    CHECK(((unsigned long)a & 15) == 0 && ((unsigned long)b & 15) == 0);
+    CHECK(((unsigned long)e & 63) == 0);
+    CHECK(b >= a + 10);
+    CHECK(c != d);
+    CHECK(liveAllocations() == before + 1);
+
+    // more than a chunk holds gets a chunk of its own
+    unsigned char* large = (unsigned char*)arena.allocate(16_KB);
+    CHECK(large != 0 && !inside(large, a, 4_KB));
+    large[0] = 1;
+    large[16_KB - 1] = 1;
+    CHECK(liveAllocations() == before + 2);
+
+    arena.release();
+    CHECK(liveAllocations() == before);
+}
+
+static void testResetReuse() {
+    uint32_t before = liveAllocations();
+    Arena arena(4_KB);
+
+    void* first[64];
+    for(int i = 0; i < 64; i++)
+        first[i] = arena.allocate(200);
+
+    uint32_t chunks = liveAllocations() - before;
+    CHECK(chunks > 1);
+
+    // the same sequence after a reset lands on the same addresses without new chunks
+    for(int round = 0; round < 10; round++) {
+        arena.reset();
+        for(int i = 0; i < 64; i++) {
+            void* again = arena.allocate(200);
+            if(again != first[i]) {
+                CHECK(again == first[i]);
+                break;
+            }
+        }
+    }
+
+    CHECK(liveAllocations() - before == chunks);
+
+    arena.release();
+    CHECK(liveAllocations() == before);
+}
+
+static void testSkippedChunks() {
+    uint32_t before = liveAllocations();
+    Arena arena(4_KB);
+
+    // round one: a small chunk followed by an oversized one
+    void* small = arena.allocate(64);
+    void* large = arena.allocate(16_KB);
+    CHECK(small != 0 && large != 0);
+    CHECK(liveAllocations() == before + 2);
+
+    // round two starts with a request the small chunk can not hold, it is skipped
+    arena.reset();
+    void* big = arena.allocate(8_KB);
+    CHECK(big == large);
+    CHECK(liveAllocations() == before + 2);
+
+    // the large chunk can not hold this, a new chunk of exactly that size follows it
+    void* rest = arena.allocate(9_KB);
+    CHECK(rest != 0 && !inside(rest, large, 16_KB) && !inside(rest, small, 4_KB));
+    CHECK(liveAllocations() == before + 3);
+
+    // the skipped chunk would hold this but is behind the current one, it stays unused this round
+    void* after = arena.allocate(2_KB);
+    CHECK(after != 0 && !inside(after, small, 4_KB) && !inside(after, rest, 9_KB));
+    CHECK(liveAllocations() == before + 4);
+
+    // the next round begins at the first chunk again
+    arena.reset();
+    CHECK(arena.allocate(64) == small);
+    CHECK(liveAllocations() == before + 4);
+
+    arena.release();
+    CHECK(liveAllocations() == before);
+}
+
+static void testList() {
+    uint32_t before = liveAllocations();
+    Arena arena;
+    void* marker = arena.allocate(1);
+
+    {
+        // uint32_t elements, with int remove(index) and remove(element) would be ambiguous
+        List<uint32_t> list(&arena);
+        for(uint32_t i = 0; i < 100; i++)
+            list.push_back(i);
+        list.push_front(1000);
+
+        CHECK(list.size() == 101);
+        CHECK(list[0] == 1000 && list[100] == 99);
+
+        list.remove(0);
+        list -= 50;
+        CHECK(list.size() == 99);
+
+        uint32_t sum = 0;
+        bool fromArena = true;
+        for(List<uint32_t>::iterator it = list.begin(); it != list.end(); ++it) {
+            sum += *it;
+            fromArena = fromArena && inside(&*it, marker, ARENA_CHUNK_SIZE);
+        }
+        CHECK(sum == 99 * 100 / 2 - 50);
+        CHECK(fromArena);
+        CHECK(liveAllocations() == before + 1);
+
+        list.clear();
+        CHECK(list.size() == 0);
+        list.push_back(7);
+        CHECK(list.size() == 1 && list[0] == 7);
+    }
+
+    arena.reset();
+    CHECK(arena.allocate(1) == marker);
+    CHECK(liveAllocations() == before + 1);
+
+    arena.release();
+    CHECK(liveAllocations() == before);
+}
+
+static void testVector() {
+    uint32_t before = liveAllocations();
+    Arena arena;
+    void* marker = arena.allocate(1);
+
+    {
+        Vector<int> vector(&arena);
+        for(int i = 0; i < 1000; i++)
+            vector.push_back(i);
+
+        CHECK(vector.size() == 1000);
+        CHECK(inside(vector.data(), marker, ARENA_CHUNK_SIZE));
+
+        int wrong = 0;
+        for(int i = 0; i < 1000; i++)
+            if(vector[i] != i)
+                wrong++;
+        CHECK(wrong == 0);
+
+        vector.pop_back();
+        CHECK(vector.size() == 999 && vector[998] == 998);
+        CHECK(liveAllocations() == before + 1);
+
+        vector.clear();
+        CHECK(vector.size() == 0 && vector.data() == 0);
+        vector.push_back(3);
+        CHECK(vector.size() == 1 && vector[0] == 3);
+    }
+
+    // outgrown buffers stay in the arena until the reset hands the chunk out again
+    arena.reset();
+    CHECK(arena.allocate(1) == marker);
+    CHECK(liveAllocations() == before + 1);
+
+    arena.release();
+    CHECK(liveAllocations() == before);
+}
+
+int main() {
+    userHeap::initialize();
+
+    testAllocate();
+    testResetReuse();
+    testSkippedChunks();
+    testList();
+    testVector();
+
+    if(failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all arena checks passed\n");
+    return 0;
+}
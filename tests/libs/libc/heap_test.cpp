@@ -0,0 +1,360 @@
+//
+//  heap_test.cpp
+//  pranaOS
+//
+//  host test for pranaOSHeap::userHeap, the heap syscalls are served from a
+//  static arena so the 32 bit addresses of the heap stay valid on the host.
+//
+//  the libc headers shadow the host ones, so the few host functions needed
+//  are declared here. __KERNEL__ keeps systeminfo.h away from common/types.h,
+//  which is not part of this tree, the lines below stand in for it.
+//  The cache shard test switches stacks with x86-64 asm, so the host has to be one.
+//
+//  build: g++ -O2 -no-pie -fpermissive -w -D__KERNEL__ -I libs/libc/include -o heap_test tests/libs/libc/heap_test.cpp
+//  run:   ./heap_test
+//
+
+#include <types.h>
+
+using namespace pranaOSTypes;
+
+namespace pranaOSsystemInfo {
+    struct sharedSystemInfo;
+}
+using pranaOSsystemInfo::sharedSystemInfo;
+
+#include "../../../libs/libc/src/heap.cpp"
+
+extern "C" int printf(const char* format, ...);
+extern "C" int vprintf(const char* format, __builtin_va_list args);
+
+using namespace pranaOSHeap;
+using namespace pranaOSSyscall;
+
+alignas(SLAB_SIZE) static unsigned char arena[12 << 20];
+static uint32_t heapEnd = 0;
+
+// start the heap off a slab boundary, the slab map must cope with that
+static uint32_t heapStart() {
+    return (uint32_t)(unsigned long)arena + 4_KB;
+}
+
+int pranaOSSyscall::DoSyscall(uint32_t intNum, uint32_t arg1, uint32_t, uint32_t, uint32_t, uint32_t) {
+    if(heapEnd == 0)
+        heapEnd = heapStart() + 1_MB;
+
+    switch(intNum) {
+        case SYSCALL_GET_HEAP_START:
+            return heapStart();
+        case SYSCALL_GET_HEAP_END:
+            return heapEnd;
+        case SYSCALL_SET_HEAP_SIZE:
+            heapEnd = arg1;
+            return 1;
+    }
+
+    return 0;
+}
+
+void pranaOSLog::print(const char* format, ...) {
+    __builtin_va_list args;
+    __builtin_va_start(args, format);
+    vprintf(format, args);
+    __builtin_va_end(args);
+}
+
+static uint32_t randomState = 1;
+
+static uint32_t random() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static void fill(void* data, uint8_t value, uint32_t size) {
+    for(uint32_t i = 0; i < size; i++)
+        ((uint8_t*)data)[i] = value;
+}
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if(!(condition)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while(0)
+
+// payloads follow a memoryHeader, 16 bytes on i386 but 24 with the 8 byte pointers of the host
+#define PAYLOAD_ALIGN (sizeof(memoryHeader) % 16 == 0 ? 16 : 8)
+
+/**
+ * @brief live objects and large blocks, slab chunks kept for reuse do not count
+ */
+static uint32_t liveAllocations() {
+    heapStatistics statistics;
+    userHeap::getStatistics(&statistics);
+
+    uint32_t live = statistics.largeLiveBlocks;
+    for(int i = 0; i < SLAB_CLASSES; i++)
+        live += statistics.classes[i].liveObjects;
+
+    return live;
+}
+
+static void testMallocFree() {
+    uint32_t before = liveAllocations();
+
+    static unsigned char* blocks[64];
+    for(int i = 0; i < 64; i++) {
+        uint32_t size = 1 + i * 97;
+        blocks[i] = (unsigned char*)userHeap::malloc(size);
+        CHECK(blocks[i] != 0);
+        CHECK(((unsigned long)blocks[i] & (PAYLOAD_ALIGN - 1)) == 0);
+        fill(blocks[i], i, size);
+    }
+
+    for(int i = 0; i < 64; i++) {
+        for(uint32_t k = 0; k < 1 + (uint32_t)i * 97; k++) {
+            if(blocks[i][k] != i) {
+                CHECK(blocks[i][k] == i);
+                break;
+            }
+        }
+        userHeap::free(blocks[i]);
+    }
+
+    CHECK(liveAllocations() == before);
+    userHeap::free(0);
+}
+
+// up to 16 bytes alignedMalloc relies on the payload alignment checked above
+static void testAlignedMalloc() {
+    for(uint32_t align = 32; align <= 64_KB; align <<= 1) {
+        void* small = userHeap::alignedMalloc(24, align);
+        void* large = userHeap::alignedMalloc(5000, align);
+        CHECK(small != 0 && ((unsigned long)small & (align - 1)) == 0);
+        CHECK(large != 0 && ((unsigned long)large & (align - 1)) == 0);
+
+        fill(small, 0xA5, 24);
+        fill(large, 0x5A, 5000);
+        userHeap::alignedFree(small);
+        userHeap::alignedFree(large);
+    }
+}
+
+// large blocks bypass the slabs, three neighbours freed in any order must merge back into one.
+// Runs on the fresh heap, so the blocks are carved front to back out of the single free block
+static void testCoalescing() {
+    const uint32_t size = 8_KB;
+
+    unsigned char* a = (unsigned char*)userHeap::malloc(size);
+    unsigned char* b = (unsigned char*)userHeap::malloc(size);
+    unsigned char* c = (unsigned char*)userHeap::malloc(size);
+    void* guard = userHeap::malloc(size);
+    CHECK(a != 0 && b != 0 && c != 0 && guard != 0);
+    CHECK(b == a + size + sizeof(memoryHeader) && c == b + size + sizeof(memoryHeader));
+
+    userHeap::free(a);
+    userHeap::free(c);
+    userHeap::free(b);
+
+    void* merged = userHeap::malloc(3 * size + 2 * sizeof(memoryHeader));
+    CHECK(merged == a);
+
+    userHeap::free(merged);
+    userHeap::free(guard);
+}
+
+static void testTrim() {
+    uint32_t start = DoSyscall(SYSCALL_GET_HEAP_START);
+
+    static void* blocks[2000];
+    for(int i = 0; i < 2000; i++) {
+        blocks[i] = userHeap::malloc(3000 + i);
+        CHECK(blocks[i] != 0);
+    }
+
+    uint32_t grown = DoSyscall(SYSCALL_GET_HEAP_END) - start;
+    CHECK(grown > 4_MB);
+
+    for(int i = 0; i < 2000; i += 2)
+        userHeap::free(blocks[i]);
+    for(int i = 1; i < 2000; i += 2)
+        userHeap::free(blocks[i]);
+
+    // only HEAP_INCREASE_SIZE of the free tail is kept past the trim threshold
+    uint32_t trimmed = DoSyscall(SYSCALL_GET_HEAP_END) - start;
+    CHECK(trimmed < grown);
+    CHECK(trimmed <= 1_MB + HEAP_TRIM_THRESHOLD);
+}
+
+struct stressBlock {
+    unsigned char* data;
+    uint32_t size;
+    unsigned char value;
+};
+
+static void testStress() {
+    const int count = 4000;
+    static stressBlock blocks[count];
+    uint32_t before = liveAllocations();
+    int corrupted = 0;
+
+    for(int i = 0; i < 400000; i++) {
+        stressBlock* block = &blocks[random() % count];
+
+        if(block->data) {
+            for(uint32_t k = 0; k < block->size; k++) {
+                if(block->data[k] != block->value) {
+                    corrupted++;
+                    break;
+                }
+            }
+            userHeap::free(block->data);
+            block->data = 0;
+            continue;
+        }
+
+        uint32_t size = random() % 100 < 90 ? 1 + random() % 256 : 1 + random() % 6000;
+        uint32_t align = random() % 50 == 0 ? 4_KB : 0;
+
+        block->data = (unsigned char*)(align ? userHeap::alignedMalloc(size, align) : userHeap::malloc(size));
+        CHECK(block->data != 0);
+        if(block->data == 0)
+            continue;
+
+        CHECK(align == 0 || ((unsigned long)block->data & (align - 1)) == 0);
+        block->size = size;
+        block->value = random();
+        fill(block->data, block->value, size);
+    }
+
+    for(int i = 0; i < count; i++)
+        if(blocks[i].data)
+            userHeap::free(blocks[i].data);
+
+    CHECK(corrupted == 0);
+    CHECK(liveAllocations() == before);
+}
+
+/* threads pick their cache shard by hashing the stack pointer, so the shard tests switch stacks.
+   Every stack is one 64 KB aligned block, the whole of it hashes to the same shard */
+alignas(1 << HEAP_CACHE_STACK_SHIFT) static unsigned char stacks[16][1 << HEAP_CACHE_STACK_SHIFT];
+
+static uint32_t shardOf(unsigned char* stack) {
+    return ((((uint32_t)(unsigned long)stack >> HEAP_CACHE_STACK_SHIFT) * 2654435761u) >> 16) % HEAP_CACHE_SHARDS;
+}
+
+static void runOnStack(unsigned char* stack, void (*function)()) {
+    unsigned char* top = stack + sizeof(stacks[0]) - 64;
+
+    asm volatile (
+        "mov %%rsp, %%rbx\n\t"
+        "mov %0, %%rsp\n\t"
+        "call *%1\n\t"
+        "mov %%rbx, %%rsp"
+        :: "r" (top), "r" (function)
+        : "rax", "rbx", "rcx", "rdx", "rsi", "rdi", "r8", "r9", "r10", "r11",
+          "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+          "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", "cc", "memory");
+}
+
+// enough objects for several fills on the allocating shard and a drain on the freeing one
+#define SHARD_OBJECTS (HEAP_CACHE_LIMIT + 2 * HEAP_CACHE_BATCH)
+#define SHARD_OBJECT_SIZE 24
+
+static unsigned char* shardObjects[SHARD_OBJECTS];
+static int shardCorrupted = 0;
+
+static void allocateObjects() {
+    for(int i = 0; i < SHARD_OBJECTS; i++) {
+        shardObjects[i] = (unsigned char*)userHeap::malloc(SHARD_OBJECT_SIZE);
+        if(shardObjects[i])
+            fill(shardObjects[i], i, SHARD_OBJECT_SIZE);
+    }
+}
+
+static void freeObjects() {
+    for(int i = 0; i < SHARD_OBJECTS; i++) {
+        for(uint32_t k = 0; shardObjects[i] && k < SHARD_OBJECT_SIZE; k++) {
+            if(shardObjects[i][k] != (unsigned char)i) {
+                shardCorrupted++;
+                break;
+            }
+        }
+        userHeap::free(shardObjects[i]);
+    }
+}
+
+static unsigned char* reused;
+
+static void allocateOne() {
+    reused = (unsigned char*)userHeap::malloc(SHARD_OBJECT_SIZE);
+}
+
+// objects allocated on one shard and freed on another land in the freeing shard's cache,
+// drainCache has to hand them back to the slabs or the allocating shard keeps growing the heap
+static void testCacheShards() {
+    unsigned char* owner = stacks[0];
+    unsigned char* other = 0;
+    for(int i = 1; i < 16 && other == 0; i++)
+        if(shardOf(stacks[i]) != shardOf(owner))
+            other = stacks[i];
+    CHECK(other != 0);
+    if(other == 0)
+        return;
+
+    uint32_t before = liveAllocations();
+    heapStatistics statistics;
+
+    runOnStack(owner, allocateObjects);
+    for(int i = 0; i < SHARD_OBJECTS; i++) {
+        CHECK(shardObjects[i] != 0);
+        CHECK(i == 0 || shardObjects[i] != shardObjects[i - 1]);
+    }
+    CHECK(liveAllocations() == before + SHARD_OBJECTS);
+
+    runOnStack(other, freeObjects);
+    CHECK(shardCorrupted == 0);
+    CHECK(liveAllocations() == before);
+
+    // the free lists are lifo, so the other shard hands out what it was given last
+    runOnStack(other, allocateOne);
+    CHECK(reused == shardObjects[SHARD_OBJECTS - 1]);
+    runOnStack(other, []() { userHeap::free(reused); });
+
+    userHeap::getStatistics(&statistics);
+    uint32_t heapSize = statistics.heapSize;
+
+    for(int round = 0; round < 100; round++) {
+        runOnStack(owner, allocateObjects);
+        runOnStack(other, freeObjects);
+    }
+
+    userHeap::getStatistics(&statistics);
+    CHECK(shardCorrupted == 0);
+    CHECK(statistics.heapSize == heapSize);
+    CHECK(liveAllocations() == before);
+}
+
+int main() {
+    userHeap::initialize();
+
+    testCoalescing();
+    testMallocFree();
+    testAlignedMalloc();
+    testCacheShards();
+    testTrim();
+    testStress();
+
+    if(failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all heap checks passed\n");
+    return 0;
+}